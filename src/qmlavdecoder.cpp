@@ -3,6 +3,9 @@
 #include "qmlavoptions.h"
 #include "qmlavframe.h"
 #include "qmlavhwoutput.h"
+#include "qmlavvideobuffer.h"
+
+#include <cstring>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -10,27 +13,58 @@ extern "C" {
 #include <libavutil/hwcontext.h>
 }
 
-#define PACKETS_LIMIT 64
 #define VIDEO_FRAMES_LIMIT 8
 #define AUDIO_FRAMES_LIMIT 32
 
+namespace {
+// Software video decoders opened in the process, see QmlAVOptions::ShareThreadCount
+std::atomic<int> s_softwareDecoders = 0;
+
+bool isSameChannelLayout(const AVCodecParameters *a, const AVCodecParameters *b)
+{
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(59, 24, 100)
+    return a->channels == b->channels && a->channel_layout == b->channel_layout;
+#else
+    return av_channel_layout_compare(&a->ch_layout, &b->ch_layout) == 0;
+#endif
+}
+}
+
 QmlAVDecoder::QmlAVDecoder(QmlAVMediaContextHolder *context, Type type)
     : m_avCodecCtx(nullptr)
     , m_type(type)
     , m_context(context)
-    , m_avStream(nullptr)
+    , m_streamIndex(-1)
+    , m_codecPar(avcodec_parameters_alloc())
+    , m_timeBase({0, 1})
+    , m_startTime(AV_NOPTS_VALUE)
+    , m_softwareDecoding(false)
+    , m_decodeMode(DecodeFull)
+    , m_codecDecodeMode(DecodeFull)
+    , m_lastPacketDts(AV_NOPTS_VALUE)
+    , m_dropLatency(0)
+    , m_dropUntilKeyFrame(false)
     , m_threadTask(&QmlAVDecoder::worker)
 {
     qRegisterMetaType<std::shared_ptr<QmlAVFrame>>();
 
-    m_thread = m_threadTask.getLiveController();
+    // Decoding never blocks on I/O, so decoders of all players share the process-wide pool
+    m_thread = m_threadTask.getLiveController(QmlAVWorkerThread::Pooled);
     m_threadTask.argsQueue()->setProducerLimit(PACKETS_LIMIT);
+    m_threadTask.argsQueue()->setWeigher([this](const auto &args) {
+        return packetWeight(std::get<AVPacketPtr>(args));
+    });
 }
 
 QmlAVDecoder::~QmlAVDecoder()
 {
     m_thread.requestInterrupt(true);
     avcodec_free_context(&m_avCodecCtx);
+    avcodec_parameters_free(&m_codecPar);
+
+    if (m_softwareDecoding) {
+        --s_softwareDecoders;
+    }
 }
 
 bool QmlAVDecoder::open(int streamIndex, const QmlAVOptions &avOptions)
@@ -68,7 +102,12 @@ bool QmlAVDecoder::open(int streamIndex, const QmlAVOptions &avOptions)
             return false;
         }
 
+        initThreads(avStream, avOptions);
+
         AVDictionaryPtr opts = static_cast<AVDictionaryPtr>(avOptions);
+        // Already resolved per stream by initThreads()
+        opts.remove("threads");
+        opts.remove("thread_type");
         ret = avcodec_open2(m_avCodecCtx, codec, opts);
         if (ret  < 0) {
             logWarning() << QString("Unable initialize codec context: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
@@ -77,7 +116,12 @@ bool QmlAVDecoder::open(int streamIndex, const QmlAVOptions &avOptions)
 
         logDebug() << "avcodec_open2() options ignored: " << QmlAV::Quote << opts.toString();
 
-        m_avStream = avStream;
+        avcodec_parameters_copy(m_codecPar, avStream->codecpar);
+        m_timeBase = avStream->time_base;
+        m_startTime = avStream->start_time;
+        m_streamIndex = avStream->index;
+        m_threadTask.argsQueue()->setWeightLimit({avOptions.packetQueueSize(), avOptions.packetQueueDuration()});
+        m_dropLatency = avOptions.packetDropLatency();
 
         return true;
     }
@@ -98,49 +142,265 @@ QString QmlAVDecoder::name() const
 bool QmlAVDecoder::decodeAVPacket(const AVPacketPtr &avPacket)
 {
     if (isOpen()) {
-        m_threadTask(this, avPacket);
+        if (!dropAVPacket(avPacket)) {
+            m_threadTask(this, avPacket);
+        }
         return true;
     }
 
     return false;
 }
 
-QmlAVLoopController QmlAVDecoder::worker(const AVPacketPtr &avPacket)
+// The codec context has been set up for these very parameters, and the queued packets are timed in this time base
+bool QmlAVDecoder::isCompatible(const AVStream *avStream) const
 {
-    AVFramePtr avFrame;
+    const AVCodecParameters *p = avStream->codecpar;
+
+    return isOpen()
+            && p->codec_type == m_codecPar->codec_type
+            && p->codec_id == m_codecPar->codec_id
+            && p->format == m_codecPar->format
+            && p->width == m_codecPar->width
+            && p->height == m_codecPar->height
+            && p->sample_rate == m_codecPar->sample_rate
+            && isSameChannelLayout(p, m_codecPar)
+            && p->extradata_size == m_codecPar->extradata_size
+            && (!p->extradata_size || memcmp(p->extradata, m_codecPar->extradata, p->extradata_size) == 0)
+            && av_cmp_q(avStream->time_base, m_timeBase) == 0;
+}
 
-    assert(m_avCodecCtx);
+void QmlAVDecoder::rebind(const AVStream *avStream)
+{
+    assert(isCompatible(avStream));
+
+    m_streamIndex = avStream->index;
+
+    // The new input starts anywhere in the GOP
+    m_lastPacketDts = AV_NOPTS_VALUE;
+    m_dropUntilKeyFrame = true;
+
+    // The flush marker follows the packets of the lost input (see worker())
+    AVPacketPtr flushPacket;
+    flushPacket->flags |= AV_PKT_FLAG_DISCARD;
+    m_threadTask(this, flushPacket);
+}
+
+void QmlAVDecoder::drain()
+{
+    if (isOpen()) {
+        // The empty packet puts the codec into the draining mode (see worker())
+        m_threadTask(this, AVPacketPtr());
+    }
+}
+
+bool QmlAVDecoder::isFlushPacket(const AVPacketPtr &avPacket)
+{
+    return avPacket->size == 0 && (avPacket->flags & AV_PKT_FLAG_DISCARD);
+}
+
+bool QmlAVDecoder::isDrainPacket(const AVPacketPtr &avPacket)
+{
+    return avPacket->size == 0 && !(avPacket->flags & AV_PKT_FLAG_DISCARD);
+}
 
-    // Get available frame from the decoder
-    int ret = avcodec_receive_frame(m_avCodecCtx, avFrame);
-    if (ret < 0) {
-        // Those two return values are special and mean there is no output
-        // frame available, but there were no errors during decoding.
-        if (ret != AVERROR_EOF && ret != AVERROR(EAGAIN)) {
-            logWarning() << QString("Unable to read decoded frame: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+void QmlAVDecoder::initThreads(const AVStream *avStream, const QmlAVOptions &avOptions)
+{
+    // NOTE: The threads of HW decoders are mostly idle and the audio decoders are cheap,
+    // so only the software video decoders share the cores
+    if (m_type == TypeVideo && !m_avCodecCtx->hw_device_ctx && !m_softwareDecoding) {
+        m_softwareDecoding = true;
+        ++s_softwareDecoders;
+    }
+
+    std::optional<int> count = avOptions.threadCount(avStream->codecpar);
+    std::optional<int> type = avOptions.threadType(avStream->codecpar);
+
+    if (count == QmlAVOptions::ShareThreadCount) {
+        // The split is fixed at open time: the decoders opened later get a smaller share,
+        // the earlier ones are not rebalanced (nor when the others are closed)
+        int cores = std::max(1u, std::thread::hardware_concurrency());
+        count = m_softwareDecoding ? std::max(1, cores / s_softwareDecoders.load()) : 1;
+
+        // Frame threading delays the output by a frame per thread
+        if (!type && m_context->clock.realTime) {
+            type = FF_THREAD_SLICE;
         }
+    }
 
-        // Submit the packet to the decoder
-        ret = avcodec_send_packet(m_avCodecCtx, avPacket);
-        if (ret < 0) {
-            logWarning() << QString("Unable send packet to decoder: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
-        } else {
-            m_counters.packetsDecoded++;
+    if (count) {
+        m_avCodecCtx->thread_count = *count;
+    }
+    if (type) {
+        m_avCodecCtx->thread_type = *type;
+    }
+
+    logDebug() << QString("%1 decoder threads: %2, type: %3").arg(typeName()).arg(m_avCodecCtx->thread_count).arg(m_avCodecCtx->thread_type);
+}
+
+// NOTE: Executes in the demuxer thread context (see QmlAVWaitingQueue::setWeigher())
+QmlAVQueueWeight QmlAVDecoder::packetWeight(const AVPacketPtr &avPacket)
+{
+    QmlAVQueueWeight weight;
+    weight.bytes = avPacket->size;
+
+    // Live sources often leave the duration unset, so take the DTS distance instead
+    int64_t duration = avPacket->duration;
+    if (duration <= 0 && avPacket->dts != AV_NOPTS_VALUE && m_lastPacketDts != AV_NOPTS_VALUE) {
+        duration = avPacket->dts - m_lastPacketDts;
+    }
+    if (avPacket->dts != AV_NOPTS_VALUE) {
+        m_lastPacketDts = avPacket->dts;
+    }
+
+    if (duration > 0 && m_timeBase.num) {
+        weight.duration = av_rescale_q(duration, m_timeBase, AV_TIME_BASE_Q);
+    }
+
+    return weight;
+}
+
+// Packet filtering of the decode mode and the GOP-aware drop policy: a live stream that the decoder
+// can't keep up with skips to the next keyframe instead of accumulating latency in the packet queue.
+// NOTE: Executes in the demuxer thread context
+bool QmlAVDecoder::dropAVPacket(const AVPacketPtr &avPacket)
+{
+    const bool keyFrame = avPacket->flags & AV_PKT_FLAG_KEY;
+    const DecodeMode mode = m_decodeMode;
+
+    bool drop = false;
+    if (mode == DecodePaused || (mode == DecodeKeyframesOnly && !keyFrame)) {
+        // Filtered out on purpose, so the full decoding has to be resumed from a keyframe
+        m_dropUntilKeyFrame = true;
+        drop = true;
+    } else {
+        // The rest of the GOP refers to the dropped packets anyway
+        if (!m_dropUntilKeyFrame || keyFrame) {
+            m_dropUntilKeyFrame = m_context->clock.realTime && m_dropLatency > 0 && packetQueueWeight().duration >= m_dropLatency;
+            if (m_dropUntilKeyFrame) {
+                logDebug() << QString("%1 packet queue exceeds %2 us latency, drop packets until the next keyframe").arg(typeName()).arg(m_dropLatency);
+            }
         }
 
+        if (m_dropUntilKeyFrame) {
+            m_counters.packetsDropped++;
+            drop = true;
+        }
+    }
+
+    // Don't count the gap in the duration of the next queued packet (see packetWeight())
+    if (drop && avPacket->dts != AV_NOPTS_VALUE) {
+        m_lastPacketDts = avPacket->dts;
+    }
+
+    return drop;
+}
+
+QmlAVLoopController QmlAVDecoder::worker(const AVPacketPtr &avPacket)
+{
+    assert(m_avCodecCtx);
+
+    if (isFlushPacket(avPacket)) {
+        // Reconnected input (see rebind()), the references and the delayed frames of the lost one are useless
+        avcodec_flush_buffers(m_avCodecCtx);
         return QmlAVLoopController::Continue;
+    }
+
+    // Drain the decoder first, otherwise it may not accept the packet
+    QmlAVLoopController ctrl = receiveFrames(QmlAVLoopController::Retry);
+    if (!ctrl.isContinue()) {
+        return ctrl;
+    }
+
+    applyDecodeMode();
+
+    const bool drain = isDrainPacket(avPacket);
+
+    // Submit the packet to the decoder
+    int ret = avcodec_send_packet(m_avCodecCtx, avPacket);
+    if (drain) {
+        // NOTE: Draining already, if retried
+        if (ret < 0 && ret != AVERROR_EOF) {
+            logWarning() << QString("Unable to drain decoder: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+        }
+    } else if (ret < 0) {
+        logWarning() << QString("Unable send packet to decoder: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
     } else {
-        if (m_frameQueueLimit.addValue(frameQueueLength())) {
+        m_counters.packetsDecoded++;
+    }
+
+    // Output the frames of this packet right away rather than on the next packet arrival.
+    // The drain packet stays queued until the last frame is out, no other packet would resume the receiving.
+    return receiveFrames(drain ? QmlAVLoopController::Retry : QmlAVLoopController::Continue);
+}
+
+// NOTE: Executes in the decoder thread context, the codec context must not be changed concurrently with decoding
+void QmlAVDecoder::applyDecodeMode()
+{
+    const DecodeMode mode = m_decodeMode;
+    if (mode == m_codecDecodeMode) {
+        return;
+    }
+
+    switch (mode) {
+    case DecodeReferenceOnly:
+        m_avCodecCtx->skip_frame = AVDISCARD_NONREF;
+        m_avCodecCtx->skip_loop_filter = AVDISCARD_NONREF;
+        break;
+    case DecodeKeyframesOnly:
+        // The keyframes are decoded at the lowest quality
+        m_avCodecCtx->skip_frame = AVDISCARD_NONKEY;
+        m_avCodecCtx->skip_loop_filter = AVDISCARD_ALL;
+        break;
+    case DecodeFull:
+    case DecodePaused:
+    default:
+        m_avCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+        m_avCodecCtx->skip_loop_filter = AVDISCARD_DEFAULT;
+        break;
+    }
+
+    m_codecDecodeMode = mode;
+    logDebug() << QString("%1 decode mode: %2").arg(typeName()).arg(mode);
+}
+
+// Receives all the frames available from the decoder. Returns Continue once the decoder is drained,
+// otherwise the waiting (sleeping) controller with the "pending" operator.
+QmlAVLoopController QmlAVDecoder::receiveFrames(QmlAVLoopController::Operator pending)
+{
+    AVFramePtr avFrame;
+
+    for (;;) {
+        if (m_type == TypeVideo && !m_context->clock.realTime && frameQueueLength() >= m_frameQueueLimit.limit()) {
+            // Local playback: wait for a free frame slot (see ~QmlAVFrame()) rather than discard the frames
+            return QmlAVLoopController::waitUntil(pending);
+        }
+
+        // Get available frame from the decoder
+        int ret = avcodec_receive_frame(m_avCodecCtx, avFrame);
+        if (ret < 0) {
+            // Those two return values are special and mean there is no output
+            // frame available, but there were no errors during decoding.
+            if (ret != AVERROR_EOF && ret != AVERROR(EAGAIN)) {
+                logWarning() << QString("Unable to read decoded frame: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+            }
 
+            return QmlAVLoopController::Continue;
+        }
+
+        if (m_frameQueueLimit.addValue(frameQueueLength())) {
             auto f = makeFrame(avFrame, m_context->shared_from_this());
             if (f && f->isValid()) {
                 m_counters.framesDecoded++;
                 m_context->demuxer->frameHandler(f);
 
-                if (!m_context->clock.realTime) {
+                // NOTE: Video frames are picked by the demuxer presentation scheduler,
+                // the decoder only runs ahead up to the frame queue limit (see above).
+                if (m_type == TypeAudio && !m_context->clock.realTime) {
                     // Primitive syncing for local playback
-                    auto presentTime = m_context->clock.startTime() + f->pts() - f->startPts();
-                    return QmlAVLoopController(QmlAVLoopController::Retry, presentTime - Clock::now());
+                    QmlAVLoopController ctrl(pending, f->presentTime() - Clock::now());
+                    if (ctrl.hasDeadline()) {
+                        return ctrl;
+                    }
                 }
             }
         } else {
@@ -148,18 +408,22 @@ QmlAVLoopController QmlAVDecoder::worker(const AVPacketPtr &avPacket)
             logDebug() << QString("Exceeding %1 frame queue limit: ").arg(typeName()) << m_frameQueueLimit;
         }
     }
-
-    return QmlAVLoopController::Retry;
 }
 
 QmlAVVideoDecoder::QmlAVVideoDecoder(QmlAVMediaContextHolder *context)
     : QmlAVDecoder(context, TypeVideo)
+    , m_renderSize(QSize())
+    , m_scaler(m_framePool)
+    , m_bufferPool(std::make_unique<QmlAVVideoBufferPool>())
 {
     m_frameQueueLimit.setLimit(VIDEO_FRAMES_LIMIT);
 }
 
 QmlAVVideoDecoder::~QmlAVVideoDecoder()
 {
+    // NOTE: The decoder thread is finished in the base class destructor, so it must not use the scaler anymore
+    requestInterrupt(true);
+
     if (m_avCodecCtx) {
         av_buffer_unref(&m_avCodecCtx->hw_device_ctx);
     }
@@ -199,6 +463,31 @@ bool QmlAVVideoDecoder::initVideoDecoder(const QmlAVOptions &avOptions)
         m_avCodecCtx->hw_device_ctx = av_buffer_ref(avHWDeviceCtx);
 
         av_buffer_unref(&avHWDeviceCtx);
+    } else {
+        // Software frames may still be converted on the GPU
+        m_hwOutput = avOptions.hwOutput();
+
+        // The cheapest way to get small frames: the codec decodes at 1/2, 1/4 or 1/8 of the size right away
+        QSize renderSize = m_renderSize;
+        int maxLowres = m_avCodecCtx->codec ? m_avCodecCtx->codec->max_lowres : 0;
+        if (renderSize.isValid() && !renderSize.isEmpty() && m_avCodecCtx->width > 0 && m_avCodecCtx->height > 0) {
+            int lowres = 0;
+            while (lowres < maxLowres &&
+                   (m_avCodecCtx->width >> (lowres + 1)) >= renderSize.width() &&
+                   (m_avCodecCtx->height >> (lowres + 1)) >= renderSize.height()) {
+                ++lowres;
+            }
+
+            if (lowres > 0) {
+                m_avCodecCtx->lowres = lowres;
+                logDebug() << QString("Low-res decoding 1/%1 for %2x%3 render size").arg(1 << lowres).arg(renderSize.width()).arg(renderSize.height());
+            }
+        }
+    }
+
+    m_scaler.setThreadCount(avOptions.scalerThreadCount());
+    if (auto flags = avOptions.scalerFlags()) {
+        m_scaler.setFlags(flags.value());
     }
 
     return true;
@@ -237,7 +526,34 @@ AVPixelFormat QmlAVVideoDecoder::negotiatePixelFormatCb(AVCodecContext *avCodecC
 
 const std::shared_ptr<QmlAVFrame> QmlAVVideoDecoder::makeFrame(const AVFramePtr &avFrame, const std::shared_ptr<QmlAVMediaContextHolder> &context) const
 {
-    return std::make_shared<QmlAVVideoFrame>(avFrame, context);
+    return std::make_shared<QmlAVVideoFrame>(downscale(avFrame), context);
+}
+
+// Downscales the SW-frames much larger than the render size in the decoder thread, straight to the Qt native
+// pixel format, so the video buffer doesn't have to convert the full size frame on the GUI thread.
+AVFramePtr QmlAVVideoDecoder::downscale(const AVFramePtr &avFrame) const
+{
+    QSize renderSize = m_renderSize;
+    if (!renderSize.isValid() || renderSize.isEmpty() || avFrame->hw_frames_ctx || avFrame->width <= 0 || avFrame->height <= 0) {
+        return avFrame;
+    }
+
+    // Cover the render size keeping the aspect ratio, not worth it for less than 25%
+    double scale = std::max(static_cast<double>(renderSize.width()) / avFrame->width,
+                            static_cast<double>(renderSize.height()) / avFrame->height);
+    if (scale > 0.75) {
+        return avFrame;
+    }
+
+    int width = std::max(2, static_cast<int>(avFrame->width * scale) & ~1);
+    int height = std::max(2, static_cast<int>(avFrame->height * scale) & ~1);
+
+    AVFramePtr avFrameSws = m_scaler.scale(avFrame, width, height, QmlAVPixelFormat(avFrame->format).nearestQtNative());
+    if (!avFrameSws) {
+        return avFrame;
+    }
+
+    return avFrameSws;
 }
 
 QmlAVAudioDecoder::QmlAVAudioDecoder(QmlAVMediaContextHolder *context)
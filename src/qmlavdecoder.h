@@ -10,6 +10,10 @@ extern "C" {
 
 #include "qmlavthread.h"
 #include "qmlavresampler.h"
+#include "qmlavscaler.h"
+
+// NOTE: Just a safety cap, the packet queue is bounded by size and duration (see QmlAVOptions)
+#define PACKETS_LIMIT 256 // Power of two, also the capacity of the lock-free packet queue
 
 struct AVCodecContext;
 
@@ -17,6 +21,7 @@ class QmlAVMediaContextHolder;
 class QmlAVOptions;
 class QmlAVFrame;
 class QmlAVHWOutput;
+class QmlAVVideoBufferPool;
 
 class QmlAVDecoder
 {
@@ -40,6 +45,7 @@ public:
 
     struct Counters {
         QmlAVRelaxedAtomic<uint32_t> packetsDecoded = 0;
+        QmlAVRelaxedAtomic<uint32_t> packetsDropped = 0;
         QmlAVRelaxedAtomic<uint32_t> framesDecoded = 0;
         QmlAVRelaxedAtomic<uint32_t> framesDiscarded = 0;
 
@@ -56,6 +62,13 @@ public:
         TypeAudio
     };
 
+    enum DecodeMode {
+        DecodeFull,
+        DecodeReferenceOnly, // Non-reference frames are skipped
+        DecodeKeyframesOnly, // Other packets are filtered out by the demuxer
+        DecodePaused         // All packets are filtered out by the demuxer
+    };
+
 protected:
     QmlAVDecoder(QmlAVMediaContextHolder *context, Type type = TypeUnknown);
 
@@ -75,15 +88,32 @@ public:
     bool open(int streamIndex, const QmlAVOptions &avOptions);
     bool isOpen() const;
     QString name() const;
-    const AVStream *stream() const { return m_avStream; }
-    int streamIndex() const { return m_avStream ? m_avStream->index : -1; }
+    int streamIndex() const { return m_streamIndex; }
+    // Copies of the stream properties taken on open(), the input may be reconnected meanwhile
+    const AVCodecParameters *codecParameters() const { return m_codecPar; }
+    AVRational timeBase() const { return m_timeBase; }
+    int64_t startTime() const { return m_startTime; }
+
+    // Warm reconnect (see QmlAVDemuxer::reconnect()): the open decoder is switched over to the same stream
+    // of a new input. Only the codec state is flushed, the codec (HW device) context and the output are kept.
+    // NOTE: Demuxer thread only!
+    bool isCompatible(const AVStream *avStream) const;
+    void rebind(const AVStream *avStream);
 
     bool decodeAVPacket(const AVPacketPtr &avPacket);
+    // End of the input: the delayed frames are output after the queued packets.
+    // NOTE: Demuxer thread only!
+    void drain();
+
+    DecodeMode decodeMode() const { return m_decodeMode; }
+    void setDecodeMode(DecodeMode mode) { m_decodeMode = mode; }
 
     void requestInterrupt(bool wait = false) { m_thread.requestInterrupt(wait); }
+    void wake() { m_thread.wake(); }
     void waitForEmptyPacketQueue() { m_threadTask.argsQueue()->waitForEmpty(); }
 
     int packetQueueLength() const { return m_threadTask.argsQueue()->length(); }
+    QmlAVQueueWeight packetQueueWeight() const { return m_threadTask.argsQueue()->weight(); }
     int frameQueueLength() const { return m_counters.frameQueueLength; }
 
     auto &counters() { return m_counters; }
@@ -91,6 +121,8 @@ public:
 
 protected:
     QmlAVLoopController worker(const AVPacketPtr &avPacket);
+    QmlAVLoopController receiveFrames(QmlAVLoopController::Operator pending);
+    void applyDecodeMode();
 
     virtual bool initVideoDecoder([[maybe_unused]] const QmlAVOptions &avOptions) { return true; }
     virtual const std::shared_ptr<QmlAVFrame> makeFrame([[maybe_unused]] const AVFramePtr &avFrame,
@@ -105,13 +137,31 @@ protected:
     QMLAVSoftLimit<double> m_frameQueueLimit;
 
 private:
+    void initThreads(const AVStream *avStream, const QmlAVOptions &avOptions);
+    QmlAVQueueWeight packetWeight(const AVPacketPtr &avPacket);
+    bool dropAVPacket(const AVPacketPtr &avPacket);
+    static bool isFlushPacket(const AVPacketPtr &avPacket);
+    static bool isDrainPacket(const AVPacketPtr &avPacket);
+
     Type m_type;
     // We do not use std::weak_ptr so that the class instance can be created in the constructor
     QmlAVMediaContextHolder *m_context;
 
-    const AVStream *m_avStream;
-
-    QmlAVThreadTask<decltype(&QmlAVDecoder::worker)> m_threadTask;
+    QmlAVRelaxedAtomic<int> m_streamIndex;
+    AVCodecParameters *m_codecPar;
+    AVRational m_timeBase;
+    int64_t m_startTime;
+    bool m_softwareDecoding;
+    QmlAVRelaxedAtomic<DecodeMode> m_decodeMode;
+    DecodeMode m_codecDecodeMode; // Decoder thread context only
+
+    // Demuxer thread context only
+    int64_t m_lastPacketDts;
+    int64_t m_dropLatency;
+    bool m_dropUntilKeyFrame;
+
+    // Demuxer (single producer) -> decoder (single consumer) packet queue, lock-free at high packet rates
+    QmlAVThreadTask<decltype(&QmlAVDecoder::worker), QmlAVLockFreeStorage<PACKETS_LIMIT>> m_threadTask;
     QmlAVThreadLiveController<QmlAVLoopController> m_thread;
 
     Counters m_counters;
@@ -124,14 +174,28 @@ public:
     ~QmlAVVideoDecoder() override;
 
     std::shared_ptr<QmlAVHWOutput> hwOutput() const { return m_hwOutput; }
+    auto &framePool() { return m_framePool; }
+    auto &scaler() { return m_scaler; }
+    QmlAVVideoBufferPool &bufferPool() { return *m_bufferPool; }
+
+    // The size the frames are rendered at, an empty size means the original one.
+    // NOTE: Low-res decoding is only chosen on open(), the later changes are handled by downscaling.
+    QSize renderSize() const { return m_renderSize; }
+    void setRenderSize(const QSize &size) { m_renderSize = size; }
 
 protected:
     bool initVideoDecoder(const QmlAVOptions &avOptions) override;
     static AVPixelFormat negotiatePixelFormatCb(struct AVCodecContext *avCodecCtx, const AVPixelFormat *avCodecPixelFormats);
     const std::shared_ptr<QmlAVFrame> makeFrame(const AVFramePtr &avFrame, const std::shared_ptr<QmlAVMediaContextHolder> &context) const override;
+    AVFramePtr downscale(const AVFramePtr &avFrame) const;
 
 private:
     std::shared_ptr<QmlAVHWOutput> m_hwOutput;
+
+    QmlAVRelaxedAtomic<QSize> m_renderSize;
+    QmlAVFramePool m_framePool;
+    mutable QmlAVScaler m_scaler;
+    std::unique_ptr<QmlAVVideoBufferPool> m_bufferPool;
 };
 
 class QmlAVAudioDecoder final : public QmlAVDecoder
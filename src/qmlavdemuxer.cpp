@@ -1,19 +1,53 @@
 #include "qmlavdemuxer.h"
+#include "qmlavprobecache.h"
+#include "qmlavopenscheduler.h"
+
+#include <algorithm>
+
+#include <QGuiApplication>
+#include <QScreen>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavdevice/avdevice.h>
 }
 
+#define DEFAULT_REFRESH_RATE 60.0 // Hz
+#define RECONNECT_DELAY_MIN 250000 // 250 ms
+#define RECONNECT_DELAY_MAX 8000000 // 8 sec.
+
+namespace {
+
+int64_t displayRefreshPeriod()
+{
+    qreal rate = DEFAULT_REFRESH_RATE;
+
+    QScreen *screen = qGuiApp ? qGuiApp->primaryScreen() : nullptr;
+    if (screen && screen->refreshRate() >= 1.0) {
+        rate = screen->refreshRate();
+    }
+
+    return static_cast<int64_t>(AV_TIME_BASE / rate);
+}
+
+} // namespace
+
 QmlAVDemuxer::QmlAVDemuxer(QObject *parent)
     : QObject(parent)
     , m_context(std::make_shared<QmlAVMediaContextHolder>(this))
+    , m_refreshPeriod(displayRefreshPeriod())
 {
+    m_refreshTimer.setTimerType(Qt::PreciseTimer);
+    m_refreshTimer.setInterval(std::max<int>(1, m_refreshPeriod / 1000));
+    connect(&m_refreshTimer, &QTimer::timeout, this, &QmlAVDemuxer::presentScheduledVideoFrame);
 }
 
 QmlAVDemuxer::~QmlAVDemuxer()
 {
+    m_refreshTimer.stop();
+
     m_context->interruptCallback.requestAVInterrupt();
+    QmlAVOpenScheduler::instance().cancel(m_openTicket);
 
     m_loaderThread.requestInterrupt(true);
     m_demuxerThread.requestInterrupt(true);
@@ -21,11 +55,21 @@ QmlAVDemuxer::~QmlAVDemuxer()
     // Important! Serialization point for decoders dtor's
     m_context->videoDecoder->requestInterrupt(true);
     m_context->audioDecoder->requestInterrupt(true);
+
+    // The recordings are finalized with the packets queued so far
+    if (auto recorder = std::atomic_exchange(&m_recorder, std::shared_ptr<QmlAVRecorder>())) {
+        m_stoppedRecorders.push_back(recorder);
+    }
+    m_stoppedRecorders.clear();
+
+    std::atomic_store(&m_latestVideoFrame, std::shared_ptr<QmlAVFrame>());
+
+    std::scoped_lock lock(m_scheduleMutex);
+    m_scheduledVideoFrames.clear();
 }
 
 void QmlAVDemuxer::load(const QUrl &url, const QmlAVOptions &avOptions)
 {
-    int ret = AVERROR_UNKNOWN;
     QString source(url.toString());
 
     if (m_context->avFormatCtx->iformat) {
@@ -53,25 +97,31 @@ void QmlAVDemuxer::load(const QUrl &url, const QmlAVOptions &avOptions)
 
     m_context->interruptCallback.setTimeout(avOptions.demuxerTimeout());
 
-    emit mediaStatusChanged(QMediaPlayer::LoadingMedia);
-
-    m_loaderThread = QmlAVThread::run([=]() mutable {
-        AVDictionaryPtr dict = static_cast<AVDictionaryPtr>(avOptions);
-        ret = avformat_open_input(&m_context->avFormatCtx,
-                                  source.toUtf8(),
-                                  avOptions.avInputFormat(),
-                                  dict);
-        if (ret < 0) {
-            logWarning() << QString("Unable to open input file: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
-            emit mediaStatusChanged(QMediaPlayer::InvalidMedia);
-            return;
+    m_input.source = source;
+    m_input.avOptions = avOptions;
+    // Probing a live stream may take seconds, the local files are cheap to probe
+    m_input.probeCache = avOptions.probeCache().value_or(m_context->clock.realTime);
+    // NOTE: Without the credentials, it may be persisted (the probe cache) and logged
+    m_input.sourceKey = url.toString(QUrl::RemoveUserInfo);
+    m_input.warmReconnect = avOptions.warmReconnect();
+
+    // The protocols only, the devices, the local files and the RTSP/RTP demuxers don't read through AVFormatContext::pb
+    if (!url.isLocalFile() && !isPacketProtocol(url)) {
+        const auto *avInputFormat = avOptions.avInputFormat();
+        if (!avInputFormat || !(avInputFormat->flags & AVFMT_NOFILE)) {
+            m_input.readAheadSize = avOptions.readAheadSize();
+            m_input.readAheadDelay = avOptions.readAheadDelay();
         }
+    }
 
-        logDebug() << "avformat_open_input() options ignored: " << QmlAV::Quote << dict.toString();
+    if (auto limit = avOptions.openConcurrency()) {
+        QmlAVOpenScheduler::instance().setLimit(*limit);
+    }
 
-        ret = avformat_find_stream_info(m_context->avFormatCtx, nullptr);
-        if (ret < 0) {
-            logWarning() << QString("Cannot find stream information: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+    emit mediaStatusChanged(QMediaPlayer::LoadingMedia);
+
+    m_loaderThread = QmlAVThread::run([=]() {
+        if (!openInput(m_context->avFormatCtx, m_context->readAhead)) {
             emit mediaStatusChanged(QMediaPlayer::InvalidMedia);
             return;
         }
@@ -97,6 +147,124 @@ void QmlAVDemuxer::load(const QUrl &url, const QmlAVOptions &avOptions)
     });
 }
 
+// Opens the source in the given context and finds its streams
+// NOTE: Executes in the loader or the demuxer thread context
+bool QmlAVDemuxer::openInput(AVFormatContext *&avFormatCtx, std::unique_ptr<QmlAVReadAheadIO> &readAhead)
+{
+    const int64_t queueTime = av_gettime_relative();
+
+    auto slot = QmlAVOpenScheduler::instance().acquire(m_openTicket);
+    if (!slot) {
+        return false; // Interrupted
+    }
+
+    const int64_t openTime = av_gettime_relative();
+    m_openWaitTime = openTime - queueTime;
+
+    // The time spent in the queue doesn't count
+    m_context->interruptCallback.resetTimer();
+
+    if (m_input.readAheadSize > 0) {
+        readAhead = std::make_unique<QmlAVReadAheadIO>(m_input.readAheadSize, m_input.readAheadDelay,
+                                                       m_input.avOptions.demuxerTimeout(), m_context->interruptCallback);
+        if (!readAhead->open(m_input.source, m_input.avOptions)) {
+            return false;
+        }
+
+        avFormatCtx->pb = readAhead->avioContext();
+    }
+
+    AVDictionaryPtr dict = static_cast<AVDictionaryPtr>(m_input.avOptions);
+    int ret = avformat_open_input(&avFormatCtx,
+                                  m_input.source.toUtf8(),
+                                  m_input.avOptions.avInputFormat(),
+                                  dict);
+    if (ret < 0) {
+        logWarning() << QString("Unable to open input file: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+        return false;
+    }
+
+    logDebug() << "avformat_open_input() options ignored: " << QmlAV::Quote << dict.toString();
+
+    // NOTE: The file (if any) is loaded on first use
+    QmlAVProbeCache *cache = nullptr;
+    if (m_input.probeCache) {
+        cache = &QmlAVProbeCache::instance(QString::fromStdString(m_input.avOptions.probeCacheFile()));
+    }
+
+    if (cache && cache->restore(m_input.sourceKey, avFormatCtx)) {
+        logDebug() << "Stream information restored from the cache";
+    } else {
+        ret = avformat_find_stream_info(avFormatCtx, nullptr);
+        if (ret < 0) {
+            logWarning() << QString("Cannot find stream information: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+            return false;
+        }
+
+        if (cache) {
+            cache->store(m_input.sourceKey, avFormatCtx);
+        }
+    }
+
+    m_openTime = av_gettime_relative() - openTime;
+    logInfo() << QString("%1 opened in %2 ms (queued for %3 ms)")
+                 .arg(m_input.sourceKey).arg(m_openTime.get() / 1000).arg(m_openWaitTime.get() / 1000);
+
+    return true;
+}
+
+// Warm reconnect: the lost source is reopened in a new context, and as long as it has the same streams,
+// the decoders are switched over to it. The decoder threads, the codec (HW device) contexts
+// and the outputs survive, only the codec state is flushed.
+// NOTE: Executes in the demuxer thread context
+QmlAVDemuxer::ReconnectStatus QmlAVDemuxer::reconnect()
+{
+    AVFormatContext *avFormatCtx = avformat_alloc_context();
+    if (!avFormatCtx) {
+        return ReconnectFailed;
+    }
+    avFormatCtx->interrupt_callback = m_context->interruptCallback;
+
+    std::unique_ptr<QmlAVReadAheadIO> readAhead;
+    if (!openInput(avFormatCtx, readAhead)) {
+        avformat_close_input(&avFormatCtx);
+        return ReconnectFailed;
+    }
+
+    auto *videoDecoder = m_context->videoDecoder;
+    auto *audioDecoder = m_context->audioDecoder;
+
+    int videoStream = av_find_best_stream(avFormatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    int audioStream = av_find_best_stream(avFormatCtx, AVMEDIA_TYPE_AUDIO, -1, videoStream, nullptr, 0);
+
+    auto compatible = [&](const QmlAVDecoder *decoder, int stream) {
+        return !decoder->isOpen() || (stream >= 0 && decoder->isCompatible(avFormatCtx->streams[stream]));
+    };
+
+    if (!compatible(videoDecoder, videoStream) || !compatible(audioDecoder, audioStream)) {
+        avformat_close_input(&avFormatCtx);
+        return StreamsChanged;
+    }
+
+    if (videoDecoder->isOpen()) {
+        videoDecoder->rebind(avFormatCtx->streams[videoStream]);
+    }
+    if (audioDecoder->isOpen()) {
+        audioDecoder->rebind(avFormatCtx->streams[audioStream]);
+    }
+
+    // The decoders don't refer to the lost context anymore (the queued packets are reference counted)
+    std::swap(m_context->avFormatCtx, avFormatCtx);
+    std::swap(m_context->readAhead, readAhead);
+    avformat_close_input(&avFormatCtx);
+
+    if (auto recorder = std::atomic_load(&m_recorder)) {
+        recorder->discontinuity();
+    }
+
+    return Reconnected;
+}
+
 void QmlAVDemuxer::start()
 {
     if (m_demuxerThread.isRunning()) {
@@ -105,13 +273,20 @@ void QmlAVDemuxer::start()
 
     emit playbackStateChanged(QMediaPlayer::PlayingState);
 
+    // The local playback frames are presented at the display refresh rate as long as the demuxer runs
+    if (!m_context->clock.realTime) {
+        m_refreshTimer.start();
+    }
+
     auto stop = [this](QMediaPlayer::MediaStatus status = QMediaPlayer::InvalidMedia) {
+        // NOTE: The timer belongs to the GUI thread
+        QMetaObject::invokeMethod(this, [this]() { m_refreshTimer.stop(); }, Qt::QueuedConnection);
         emit mediaStatusChanged(status);
         emit playbackStateChanged(QMediaPlayer::StoppedState);
         return QmlAVLoopController::Break;
     };
 
-    m_demuxerThread = QmlAVThread::loop([=]() mutable -> QmlAVLoopController {
+    m_demuxerThread = QmlAVThread::loop([=, reconnectAttempt = 0, endOfMedia = false]() mutable -> QmlAVLoopController {
         int ret;
         AVPacketPtr avPacket;
 
@@ -121,16 +296,59 @@ void QmlAVDemuxer::start()
             return stop();
         }
 
+        if (endOfMedia) {
+            // The refresh timer presents the last scheduled frames in due order
+            if (hasScheduledVideoFrames()) {
+                return QmlAVLoopController(m_refreshPeriod);
+            }
+
+            logDebug() << "End of media";
+            return stop(QMediaPlayer::EndOfMedia);
+        }
+
+        if (reconnectAttempt > 0) {
+            switch (reconnect()) {
+            case Reconnected:
+                logInfo() << "Reconnected after " << reconnectAttempt << " attempt(s)";
+                reconnectAttempt = 0;
+                emit mediaStatusChanged(QMediaPlayer::BufferedMedia);
+                break;
+            case ReconnectFailed: {
+                // Exponential backoff
+                int64_t delay = std::min<int64_t>(static_cast<int64_t>(RECONNECT_DELAY_MIN) << std::min(reconnectAttempt, 16),
+                                                  RECONNECT_DELAY_MAX);
+                ++reconnectAttempt;
+                logDebug() << "Next reconnect attempt in " << delay / 1000 << " ms";
+                return QmlAVLoopController(delay);
+            }
+            case StreamsChanged:
+                // The decoders have to be recreated, leave it to the player
+                logInfo() << "The streams have changed, unable to reconnect in place";
+                return stop();
+            }
+        }
+
         m_context->interruptCallback.resetTimer();
 
         ret = av_read_frame(m_context->avFormatCtx, avPacket);
         if (ret < 0) {
+            // NOTE: A clean end of the stream is not a lost connection
+            if (m_input.warmReconnect && ret != AVERROR_EOF && !m_context->interruptCallback.isAVInterruptRequested()) {
+                logWarning() << QString("Input lost: \"%1\" (%2), reconnecting").arg(av_err2str(ret)).arg(ret);
+                reconnectAttempt = 1;
+                emit mediaStatusChanged(QMediaPlayer::StalledMedia);
+                return QmlAVLoopController(RECONNECT_DELAY_MIN);
+            }
+
             if (ret == AVERROR_EOF) {
+                // The drain packets are dequeued once the delayed frames are out
+                m_context->videoDecoder->drain();
+                m_context->audioDecoder->drain();
                 m_context->videoDecoder->waitForEmptyPacketQueue();
                 m_context->audioDecoder->waitForEmptyPacketQueue();
 
-                logDebug() << "End of media";
-                return stop(QMediaPlayer::EndOfMedia);
+                endOfMedia = true;
+                return QmlAVLoopController::Continue;
             }
 
             if (ret != AVERROR_EXIT) {
@@ -140,30 +358,114 @@ void QmlAVDemuxer::start()
             return stop();
         }
 
+        // NOTE: Ahead of the decoders, so the decode mode doesn't affect the recording
+        auto recorder = std::atomic_load(&m_recorder);
+
         if (avPacket->stream_index == m_context->videoDecoder->streamIndex()) {
+            if (recorder) {
+                recorder->write(QmlAVDecoder::TypeVideo, avPacket);
+            }
             m_context->videoDecoder->decodeAVPacket(avPacket) || stop();
         } else if (avPacket->stream_index == m_context->audioDecoder->streamIndex()) {
+            if (recorder) {
+                recorder->write(QmlAVDecoder::TypeAudio, avPacket);
+            }
             m_context->audioDecoder->decodeAVPacket(avPacket) || stop();
-        } else {
-            return 1; // Minimal sleep time
         }
 
         return QmlAVLoopController::Continue;
     });
 }
 
+bool QmlAVDemuxer::startRecording(const QString &url, const QmlAVOptions &avOptions)
+{
+    if (m_loaderThread.isRunning() || !isLoaded()) {
+        logWarning() << "Unable to record, the media is not loaded";
+        return false;
+    }
+
+    stopRecording();
+
+    auto recorder = std::make_shared<QmlAVRecorder>(url, avOptions);
+    for (const QmlAVDecoder *decoder : std::initializer_list<const QmlAVDecoder *>{ m_context->videoDecoder, m_context->audioDecoder }) {
+        if (decoder->isOpen()) {
+            recorder->addStream(decoder->type(), decoder->codecParameters(), decoder->timeBase());
+        }
+    }
+
+    // The failed recording is stopped in the GUI thread, unless it has been replaced meanwhile
+    recorder->setErrorHandler([this, r = recorder.get()]() {
+        QMetaObject::invokeMethod(this, [this, r]() {
+            if (std::atomic_load(&m_recorder).get() == r) {
+                stopRecording();
+            }
+        }, Qt::QueuedConnection);
+    });
+
+    recorder->start();
+    std::atomic_store(&m_recorder, recorder);
+
+    emit recordingChanged(true);
+
+    return true;
+}
+
+void QmlAVDemuxer::stopRecording()
+{
+    // The finished ones are released here, so the GUI thread doesn't wait for the output
+    m_stoppedRecorders.erase(std::remove_if(m_stoppedRecorders.begin(), m_stoppedRecorders.end(), [](const auto &recorder) {
+        return recorder->isFinished();
+    }), m_stoppedRecorders.end());
+
+    auto recorder = std::atomic_exchange(&m_recorder, std::shared_ptr<QmlAVRecorder>());
+    if (!recorder) {
+        return;
+    }
+
+    recorder->stop();
+    m_stoppedRecorders.push_back(recorder);
+
+    emit recordingChanged(false);
+}
+
+// NOTE: Audio is always decoded in full
+void QmlAVDemuxer::setDecodeMode(QmlAVDecoder::DecodeMode mode)
+{
+    m_context->videoDecoder->setDecodeMode(mode);
+
+    // The players shown in full are opened first, the paused (e.g. hidden) ones last
+    QmlAVOpenScheduler::instance().setPriority(m_openTicket, QmlAVDecoder::DecodePaused - mode);
+}
+
+void QmlAVDemuxer::setRenderSize(const QSize &size)
+{
+    m_context->videoDecoder->setRenderSize(size);
+}
+
 QVariantMap QmlAVDemuxer::stat() const
 {
     auto &vc = m_context->videoDecoder->counters();
     auto &ac = m_context->audioDecoder->counters();
-    return {
+    QVariantMap stat = {
         { "videoPacketsDecoded", vc.packetsDecoded.get() },
+        { "videoPacketsDropped", vc.packetsDropped.get() },
         { "videoFramesDecoded", vc.framesDecoded.get() },
         { "videoFramesDiscarded", vc.framesDiscarded.get() },
         { "audioPacketsDecoded", ac.packetsDecoded.get() },
+        { "audioPacketsDropped", ac.packetsDropped.get() },
         { "audioBuffersDecoded", ac.framesDecoded.get() },
-        { "audioBuffersDiscarded", ac.framesDiscarded.get() }
+        { "audioBuffersDiscarded", ac.framesDiscarded.get() },
+        { "openWaitTime", static_cast<qint64>(m_openWaitTime.get() / 1000) }, // ms
+        { "openTime", static_cast<qint64>(m_openTime.get() / 1000) } // ms
     };
+
+    if (auto recorder = std::atomic_load(&m_recorder)) {
+        auto &rc = recorder->counters();
+        stat.insert("recordPacketsWritten", rc.packetsWritten.get());
+        stat.insert("recordPacketsDropped", rc.packetsDropped.get());
+    }
+
+    return stat;
 }
 
 bool QmlAVDemuxer::isRealTime(QUrl url) const
@@ -179,6 +481,19 @@ bool QmlAVDemuxer::isRealTime(QUrl url) const
     return false;
 }
 
+// The demuxers of these read the network themselves
+bool QmlAVDemuxer::isPacketProtocol(QUrl url) const
+{
+    if (url.scheme() == "rtp"
+            || url.scheme() == "srtp"
+            || url.scheme() == "rtsp"
+            || url.scheme() == "sdp") {
+        return true;
+    }
+
+    return false;
+}
+
 void QmlAVDemuxer::initDecoders(const QmlAVOptions &avOptions)
 {
     int bestVideoStream = av_find_best_stream(m_context->avFormatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
@@ -196,7 +511,79 @@ void QmlAVDemuxer::initDecoders(const QmlAVOptions &avOptions)
     }
 }
 
+// NOTE: Called from the decoder threads
 void QmlAVDemuxer::frameHandler(const std::shared_ptr<QmlAVFrame> frame)
 {
-    emit frameFinished(frame);
+    if (frame->type() != QmlAVFrame::TypeVideo) {
+        // Every audio frame counts
+        emit frameFinished(frame);
+        return;
+    }
+
+    if (!m_context->clock.realTime) {
+        std::scoped_lock lock(m_scheduleMutex);
+        m_scheduledVideoFrames.push_back(frame);
+        return;
+    }
+
+    // Real-time streams are presented as soon as possible
+
+    // A video frame only replaces the one the GUI thread hasn't taken yet, so the frames don't pile up
+    // in the event queue while it is busy. The replaced frame is released (and its slot freed) right here.
+    auto replaced = std::atomic_exchange(&m_latestVideoFrame, frame);
+    if (replaced) {
+        m_context->videoDecoder->counters().framesDiscarded++;
+        return; // The wake-up is already pending
+    }
+
+    QMetaObject::invokeMethod(this, &QmlAVDemuxer::presentLatestVideoFrame, Qt::QueuedConnection);
+}
+
+bool QmlAVDemuxer::hasScheduledVideoFrames()
+{
+    std::scoped_lock lock(m_scheduleMutex);
+    return !m_scheduledVideoFrames.empty();
+}
+
+void QmlAVDemuxer::presentScheduledVideoFrame()
+{
+    auto frame = nextScheduledVideoFrame();
+    if (frame) {
+        emit frameFinished(frame);
+    }
+}
+
+// Picks the frame best matching the clock at the coming display refresh, i.e. the latest one due
+// within half of the refresh period. The frames it supersedes are dropped without being presented.
+std::shared_ptr<QmlAVFrame> QmlAVDemuxer::nextScheduledVideoFrame()
+{
+    std::shared_ptr<QmlAVFrame> frame;
+    std::deque<std::shared_ptr<QmlAVFrame>> dropped;
+
+    const int64_t refreshTime = QmlAVDecoder::Clock::now() + m_refreshPeriod / 2;
+
+    {
+        std::scoped_lock lock(m_scheduleMutex);
+
+        while (!m_scheduledVideoFrames.empty() && m_scheduledVideoFrames.front()->presentTime() <= refreshTime) {
+            if (frame) {
+                dropped.push_back(std::move(frame));
+            }
+            frame = std::move(m_scheduledVideoFrames.front());
+            m_scheduledVideoFrames.pop_front();
+        }
+    }
+
+    // Released out of the lock, it wakes the decoder
+    m_context->videoDecoder->counters().framesDiscarded += static_cast<uint32_t>(dropped.size());
+
+    return frame;
+}
+
+void QmlAVDemuxer::presentLatestVideoFrame()
+{
+    auto frame = std::atomic_exchange(&m_latestVideoFrame, std::shared_ptr<QmlAVFrame>());
+    if (frame) {
+        emit frameFinished(frame);
+    }
 }
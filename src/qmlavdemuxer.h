@@ -1,15 +1,22 @@
 #ifndef QMLAVDEMUXER_H
 #define QMLAVDEMUXER_H
 
+#include <deque>
+#include <mutex>
+#include <vector>
+
 #include <QVideoFrame>
 #include <QMediaPlayer>
 #include <QVideoSurfaceFormat>
 #include <QAudioOutput>
+#include <QTimer>
 
 #include "qmlavmediacontextholder.h"
 #include "qmlavoptions.h"
 #include "qmlavthread.h"
 #include "qmlavdecoder.h"
+#include "qmlavopenscheduler.h"
+#include "qmlavrecorder.h"
 
 // NOTE: Public API for GUI thread only!
 class QmlAVDemuxer : public QObject
@@ -22,6 +29,13 @@ public:
 
     void load(const QUrl &url, const QmlAVOptions &avOptions);
     void start();
+    void setDecodeMode(QmlAVDecoder::DecodeMode mode);
+    void setRenderSize(const QSize &size);
+
+    // Tees the demuxed packets of the decoded streams into the output (see QmlAVRecorder), once loaded
+    bool startRecording(const QString &url, const QmlAVOptions &avOptions);
+    void stopRecording();
+    bool isRecording() const { return std::atomic_load(&m_recorder) != nullptr; }
 
     QVariantMap stat() const;
 
@@ -29,22 +43,69 @@ signals:
     void playbackStateChanged(QMediaPlayer::State state);
     void mediaStatusChanged(QMediaPlayer::MediaStatus status);
     void frameFinished(const std::shared_ptr<QmlAVFrame> frame);
+    void recordingChanged(bool recording);
 
 protected:
     auto &context() { return m_context; }
 
     bool isRealTime(QUrl url) const;
+    bool isPacketProtocol(QUrl url) const;
     bool isLoaded() const { return m_context->videoDecoder->isOpen() || m_context->audioDecoder->isOpen(); }
     void initDecoders(const QmlAVOptions &avOptions);
 
+    enum ReconnectStatus {
+        Reconnected,
+        ReconnectFailed, // Try again later
+        StreamsChanged   // The decoders can't be kept
+    };
+
+    bool openInput(AVFormatContext *&avFormatCtx, std::unique_ptr<QmlAVReadAheadIO> &readAhead);
+    ReconnectStatus reconnect();
+
     void frameHandler(const std::shared_ptr<QmlAVFrame> frame);
-    
+    void presentLatestVideoFrame();
+    bool hasScheduledVideoFrames();
+    void presentScheduledVideoFrame();
+    std::shared_ptr<QmlAVFrame> nextScheduledVideoFrame();
+
 private:
     QmlAVThreadLiveController<void> m_loaderThread;
     QmlAVThreadLiveController<QmlAVLoopController> m_demuxerThread;
 
     std::shared_ptr<QmlAVMediaContextHolder> m_context;
 
+    // Set by load(), the loader and the demuxer threads (re)open the input with it
+    struct Input {
+        QString source;
+        QmlAVOptions avOptions;
+        bool probeCache = false;
+        QString sourceKey;
+        bool warmReconnect = false;
+        uint32_t readAheadSize = 0; // Disabled
+        uint32_t readAheadDelay = 0;
+    } m_input;
+
+    QmlAVOpenScheduler::Ticket m_openTicket;
+    // Of the last open (or reconnect), us
+    QmlAVRelaxedAtomic<int64_t> m_openWaitTime = 0;
+    QmlAVRelaxedAtomic<int64_t> m_openTime = 0;
+
+    // The newest decoded video frame not yet taken by the GUI thread.
+    // NOTE: Accessed with the atomic std::shared_ptr functions only!
+    std::shared_ptr<QmlAVFrame> m_latestVideoFrame;
+
+    // Local playback: the decoded video frames wait here for their presentation time. At each display refresh
+    // the latest due frame is presented and the older ones are dropped. Bounded by the decoder frame queue limit.
+    std::mutex m_scheduleMutex;
+    std::deque<std::shared_ptr<QmlAVFrame>> m_scheduledVideoFrames;
+    const int64_t m_refreshPeriod; // us
+    QTimer m_refreshTimer;
+
+    // NOTE: Accessed with the atomic std::shared_ptr functions only!
+    std::shared_ptr<QmlAVRecorder> m_recorder;
+    // Stopped, still writing out the queued packets. GUI thread only.
+    std::vector<std::shared_ptr<QmlAVRecorder>> m_stoppedRecorders;
+
     friend class QmlAVDecoder;
 };
 Q_DECLARE_METATYPE(std::shared_ptr<QmlAVFrame>)
@@ -26,6 +26,10 @@ QmlAVFrame::~QmlAVFrame()
 
         m_context->clock.leftPts = pts();
         decoder()->counters().frameQueueLength -= 1;
+
+        if (m_type == TypeVideo && !m_context->clock.realTime) {
+            decoder()->wake();
+        }
     }
 }
 
@@ -45,13 +49,13 @@ QmlAVFrame::QmlAVFrame(QmlAVFrame &&other) noexcept
 
 double QmlAVFrame::timeBaseUs() const
 {
-    return av_q2d(decoder()->stream()->time_base) * AV_TIME_BASE;
+    return av_q2d(decoder()->timeBase()) * AV_TIME_BASE;
 }
 
 // PTS of the first frame of the stream in presentation order
 int64_t QmlAVFrame::startPts() const
 {
-    auto startPts = decoder()->stream()->start_time;
+    auto startPts = decoder()->startTime();
     if (startPts != AV_NOPTS_VALUE) {
         return startPts * timeBaseUs();
     }
@@ -59,6 +63,12 @@ int64_t QmlAVFrame::startPts() const
     return 0;
 }
 
+// Time (see QmlAVDecoder::Clock::now()) the frame is due at, for the local playback
+int64_t QmlAVFrame::presentTime() const
+{
+    return m_context->clock.startTime() + pts() - startPts();
+}
+
 int64_t QmlAVFrame::pts() const
 {
     int64_t pts = 0;
@@ -91,7 +101,7 @@ AVRational QmlAVVideoFrame::sampleAspectRatio() const
     AVRational sar = {1, 1};
 
     if (isValid()) {
-        auto codecpar = decoder()->stream()->codecpar;
+        auto codecpar = decoder()->codecParameters();
 
         if (avFrame()->sample_aspect_ratio.num) {
             sar = avFrame()->sample_aspect_ratio;
@@ -127,13 +137,39 @@ QmlAVColorSpace QmlAVVideoFrame::colorSpace() const
     return avFrame()->colorspace;
 }
 
+QmlAVFramePool &QmlAVVideoFrame::framePool() const
+{
+    return decoder<QmlAVVideoDecoder>()->framePool();
+}
+
+QmlAVScaler &QmlAVVideoFrame::scaler() const
+{
+    return decoder<QmlAVVideoDecoder>()->scaler();
+}
+
+QmlAVVideoBufferPool &QmlAVVideoFrame::bufferPool() const
+{
+    return decoder<QmlAVVideoDecoder>()->bufferPool();
+}
+
 QmlAVVideoFrame::operator QVideoFrame() const
 {
     QmlAVVideoBuffer *buffer;
 
     if (isValid())  {
-        if (isHWDecoded()) {
-            buffer = new QmlAVVideoBuffer_GPU(*this, decoder<QmlAVVideoDecoder>()->hwOutput());
+        auto hwOutput = decoder<QmlAVVideoDecoder>()->hwOutput();
+        if (isHWDecoded() || (hwOutput && hwOutput->isSupported(*this))) {
+            if (hwOutput) {
+                hwOutput->prepare(*this); // Ahead of the render
+            }
+            buffer = new QmlAVVideoBuffer_GPU(*this, hwOutput);
+        } else if (auto self = std::static_pointer_cast<const QmlAVVideoFrame>(weak_from_this().lock());
+                   self && pixelFormat().isQtNative()) {
+            // The hot path: no conversion, no copy of the frame
+            auto nativeBuffer = bufferPool().acquire();
+            nativeBuffer->bind(self);
+
+            return QVideoFrame(nativeBuffer, {avFrame()->width, avFrame()->height}, pixelFormat());
         } else {
             buffer = new QmlAVVideoBuffer_CPU(*this);
         }
@@ -11,8 +11,11 @@
 #include "qmlavformat.h"
 
 class QmlAVDecoder;
+class QmlAVFramePool;
+class QmlAVScaler;
+class QmlAVVideoBufferPool;
 
-class QmlAVFrame
+class QmlAVFrame : public std::enable_shared_from_this<QmlAVFrame>
 {
 public:
     enum Type
@@ -39,6 +42,7 @@ public:
     double timeBaseUs() const;
     int64_t startPts() const;
     int64_t pts() const;
+    int64_t presentTime() const;
 
 protected:
     auto &context() { return m_context; }
@@ -74,6 +78,9 @@ public:
     QmlAVPixelFormat pixelFormat() const { return avFrame()->format; }
     QmlAVPixelFormat swPixelFormat() const;
     QmlAVColorSpace colorSpace() const;
+    QmlAVFramePool &framePool() const;
+    QmlAVScaler &scaler() const;
+    QmlAVVideoBufferPool &bufferPool() const;
 
     operator QVideoFrame() const;
 };
@@ -0,0 +1,79 @@
+#include "qmlavframepool.h"
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/imgutils.h>
+}
+
+#define FRAME_POOLS_LIMIT 4 // Frame geometries in use at once, e.g. while the render size is changing
+
+QmlAVFramePool::QmlAVFramePool()
+{
+}
+
+QmlAVFramePool::~QmlAVFramePool()
+{
+    // NOTE: The pool is actually freed when the last of its buffers is released
+    for (auto &[key, pool] : m_pools) {
+        av_buffer_pool_uninit(&pool);
+    }
+}
+
+AVFramePtr QmlAVFramePool::frame(int width, int height, AVPixelFormat format)
+{
+    AVFramePtr avFrame;
+
+    int size = av_image_get_buffer_size(format, width, height, FFMPEG_ALIGNMENT);
+    if (size <= 0) {
+        return avFrame;
+    }
+
+    avFrame->buf[0] = buffer({width, height, format}, size);
+    if (!avFrame->buf[0]) {
+        return avFrame;
+    }
+
+    // All the planes in a single buffer, the same layout as av_image_get_buffer_size() expects
+    if (av_image_fill_arrays(avFrame->data, avFrame->linesize, avFrame->buf[0]->data, format, width, height, FFMPEG_ALIGNMENT) < 0) {
+        avFrame.unref();
+        return avFrame;
+    }
+
+    avFrame->extended_data = avFrame->data;
+    avFrame->width = width;
+    avFrame->height = height;
+    avFrame->format = format;
+
+    return avFrame;
+}
+
+// NOTE: The buffer is taken in lock context, an evicted pool may be uninitialized as soon as the lock is released
+AVBufferRef *QmlAVFramePool::buffer(const Key &key, int size)
+{
+    std::scoped_lock lock(m_mutex);
+
+    auto it = m_poolsIndex.find(key);
+    if (it != m_poolsIndex.end()) {
+        m_pools.splice(m_pools.begin(), m_pools, it->second);
+        return av_buffer_pool_get(it->second->second);
+    }
+
+    // Give up the least recently used geometries
+    while (m_pools.size() >= FRAME_POOLS_LIMIT) {
+        auto &[lruKey, lruPool] = m_pools.back();
+        m_poolsIndex.erase(lruKey);
+        av_buffer_pool_uninit(&lruPool);
+        m_pools.pop_back();
+    }
+
+    AVBufferPool *pool = av_buffer_pool_init(size, nullptr);
+    if (!pool) {
+        logWarning() << "Unable to allocate the frame pool";
+        return nullptr;
+    }
+
+    m_pools.emplace_front(key, pool);
+    m_poolsIndex.emplace(key, m_pools.begin());
+
+    return av_buffer_pool_get(pool);
+}
@@ -0,0 +1,46 @@
+#ifndef QMLAVFRAMEPOOL_H
+#define QMLAVFRAMEPOOL_H
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+#include <mutex>
+#include <list>
+#include <map>
+#include <tuple>
+
+#include "qmlavutils.h"
+
+struct AVBufferPool;
+struct AVBufferRef;
+
+// Recycles the buffers of the video frames produced per stream (color conversion, scaling, HW download)
+// instead of allocating multi-megabyte buffers for every frame.
+class QmlAVFramePool
+{
+public:
+    QmlAVFramePool();
+    virtual ~QmlAVFramePool();
+
+    QmlAVFramePool(const QmlAVFramePool &other) = delete;
+    QmlAVFramePool &operator=(const QmlAVFramePool &other) = delete;
+
+    // NOTE: Thread safe. Returns an empty frame on failure.
+    AVFramePtr frame(int width, int height, AVPixelFormat format);
+
+protected:
+    using Key = std::tuple<int, int, AVPixelFormat>;
+
+    AVBufferRef *buffer(const Key &key, int size);
+
+private:
+    using Pools = std::list<std::pair<Key, AVBufferPool *>>;
+
+    std::mutex m_mutex;
+    // From the most recently used one
+    Pools m_pools;
+    std::map<Key, Pools::iterator> m_poolsIndex;
+};
+
+#endif // QMLAVFRAMEPOOL_H
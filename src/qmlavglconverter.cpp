@@ -0,0 +1,432 @@
+#include "qmlavglconverter.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#include "qmlavutils.h"
+
+#include <cstdint>
+#include <string>
+
+#include <QOpenGLContext>
+// GL_RGBA8 is a desktop-GL token not present in GLES2 headers; the desktop
+// internal format is selected at runtime, so a fallback is enough for the
+// build (the GLES path never uses it).
+#ifndef GL_RGBA8
+#define GL_RGBA8 GL_RGBA
+#endif
+#include <QOpenGLExtraFunctions>
+
+namespace {
+
+constexpr GLenum kCaps[4] = {GL_BLEND, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_CULL_FACE};
+
+// ---------------------------------------------------------------------------
+// Shader sources (single body, parametrized for GLES / legacy GL / core GL)
+// ---------------------------------------------------------------------------
+
+std::string buildVertexSource(bool core, bool gles)
+{
+    std::string src;
+    if (core) {
+        src = "#version 150\n";
+    } else if (!gles) {
+        src = "#version 120\n";
+    }
+    if (core) {
+        src += "in vec2 aPos;\n"
+               "in vec2 aTex;\n"
+               "out vec2 vTex;\n"
+               "void main() {\n"
+               "    gl_Position = vec4(aPos, 0.0, 1.0);\n"
+               "    vTex = aTex;\n"
+               "}\n";
+    } else {
+        // GLES 2.0 has no explicit version line (ES 1.00 default).
+        src += "attribute vec2 aPos;\n"
+               "attribute vec2 aTex;\n"
+               "varying vec2 vTex;\n"
+               "void main() {\n"
+               "    gl_Position = vec4(aPos, 0.0, 1.0);\n"
+               "    vTex = aTex;\n"
+               "}\n";
+    }
+    return src;
+}
+
+// Build a YUV->RGB fragment shader for 1/2/3 planes, 8/10/16-bit.
+// The matrix is BT.601 limited-range (the MVP's fixed behavior); colorspace
+// handling (BT.709/2020, full range) is a separate step.
+std::string buildFragmentSource(bool core, bool gles, int planeCount, int bitDepth, bool chromaSwap)
+{
+    std::string src;
+    if (core) {
+        src = "#version 150\n";
+    } else if (gles) {
+        // `precision` is a keyword only in GLSL ES, never on desktop GL.
+        src = "precision mediump float;\n";
+    } else {
+        src = "#version 120\n";
+    }
+
+    // Sampler declarations: tex0..texN.
+    for (int i = 0; i < planeCount; ++i) {
+        src += "uniform sampler2D tex" + std::to_string(i) + ";\n";
+    }
+    if (core) {
+        src += "in vec2 vTex;\n"
+               "out vec4 fragColor;\n";
+    } else {
+        src += "varying vec2 vTex;\n";
+    }
+    const std::string sample = core ? std::string("texture") : std::string("texture2D");
+    const std::string out = core ? std::string("fragColor") : std::string("gl_FragColor");
+
+    // Normalization: GL maps integer textures to [0,1] by dividing by 65535
+    // (for R16/GR1616). P010 stores 10 significant bits in the HIGH bits of a
+    // 16-bit word, so the sampled value is v10*64/65535; scale back to v10/1023.
+    // P016 uses the full 16 bits, so GL's own normalization is already correct.
+    const char *yScale = "1.0";
+    const char *uvScale = "1.0";
+    if (bitDepth == 10) {
+        // sampled = v10 * 64 / 65535  ->  multiply by 65535/(64*1023) ~= 1.00096
+        yScale = "65535.0 / 65472.0";
+        uvScale = "65535.0 / 65472.0";
+    }
+
+    src += "void main() {\n";
+    if (planeCount == 1) {
+        // RGB passthrough.
+        src += "    " + out + " = vec4(" + sample + "(tex0, vTex).rgb, 1.0);\n";
+    } else if (planeCount == 2) {
+        // Semi-planar: tex0 = Y, tex1 = interleaved UV (or VU for NV21).
+        src += "    float y = " + sample + "(tex0, vTex).r * " + yScale + ";\n"
+               "    vec2 uv = " + sample + "(tex1, vTex).rg;\n";
+        if (chromaSwap) {
+            src += "    uv = uv.yx;\n";
+        }
+        src += "    uv -= vec2(0.5);\n"
+               "    y = (y - 0.062745) * 1.164;\n"
+               "    " + out + " = vec4(y + 1.596 * uv.y,\n"
+               "                     y - 0.391 * uv.x - 0.813 * uv.y,\n"
+               "                     y + 2.018 * uv.x, 1.0);\n";
+    } else {
+        // Planar: tex0 = Y, tex1 = U, tex2 = V.
+        src += "    float y = " + sample + "(tex0, vTex).r * " + yScale + ";\n"
+               "    float u = " + sample + "(tex1, vTex).r * " + uvScale + " - 0.5;\n"
+               "    float v = " + sample + "(tex2, vTex).r * " + uvScale + " - 0.5;\n"
+               "    y = (y - 0.062745) * 1.164;\n"
+               "    " + out + " = vec4(y + 1.596 * v,\n"
+               "                     y - 0.391 * u - 0.813 * v,\n"
+               "                     y + 2.018 * u, 1.0);\n";
+    }
+    src += "}\n";
+    return src;
+}
+
+std::string getInfoLog(GLuint obj, bool isProgram)
+{
+    GLint len = 0;
+    if (isProgram) {
+        glGetProgramiv(obj, GL_INFO_LOG_LENGTH, &len);
+    } else {
+        glGetShaderiv(obj, GL_INFO_LOG_LENGTH, &len);
+    }
+    if (len <= 1) {
+        return {};
+    }
+    std::string log(static_cast<size_t>(len - 1), '\0');
+    if (isProgram) {
+        glGetProgramInfoLog(obj, len, nullptr, log.data());
+    } else {
+        glGetShaderInfoLog(obj, len, nullptr, log.data());
+    }
+    return log;
+}
+
+} // namespace
+
+// The state is saved *before* any of our GL calls, including the FBO creation:
+// restoring our own FBO on the way out made Qt sample the texture while it was
+// still the color attachment — Mesa crashes in glDrawElements (feedback loop).
+QmlAVGLStateGuard::QmlAVGLStateGuard(QOpenGLContext *ctx)
+    : m_extra(ctx->extraFunctions())
+{
+    glGetIntegerv(GL_VIEWPORT, m_viewport);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_fbo);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &m_program);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &m_arrayBuf);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &m_elementBuf);
+    if (m_extra) {
+        m_extra->glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &m_vao);
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        m_caps[i] = glIsEnabled(kCaps[i]);
+        glDisable(kCaps[i]);
+    }
+
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &m_activeTex);
+    for (int i = 0; i < kTextureUnits; ++i) {
+        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &m_tex[i]);
+    }
+}
+
+QmlAVGLStateGuard::~QmlAVGLStateGuard()
+{
+    for (int i = 0; i < 4; ++i) {
+        if (m_caps[i]) {
+            glEnable(kCaps[i]);
+        }
+    }
+
+    // VAO first: element-array binding lives in the VAO.
+    if (m_extra) {
+        m_extra->glBindVertexArray(static_cast<GLuint>(m_vao));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(m_arrayBuf));
+    if (!m_extra || m_vao == 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLuint>(m_elementBuf));
+    }
+    glUseProgram(static_cast<GLuint>(m_program));
+
+    for (int i = 0; i < kTextureUnits; ++i) {
+        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
+        glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_tex[i]));
+    }
+    glActiveTexture(static_cast<GLenum>(m_activeTex));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_fbo));
+    glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
+}
+
+bool QmlAVGLConverter::initialize(int width, int height)
+{
+    auto *ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        return false;
+    }
+
+    cleanup();
+
+    m_gles = ctx->isOpenGLES();
+    m_coreProfile = !m_gles && ctx->format().profile() == QSurfaceFormat::CoreProfile;
+    m_width = width;
+    m_height = height;
+
+    glGenTextures(1, &m_rgbTex);
+    glBindTexture(GL_TEXTURE_2D, m_rgbTex);
+    setTextureParams();
+    glTexImage2D(GL_TEXTURE_2D, 0, m_gles ? GL_RGBA : GL_RGBA8,
+                 width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, m_rgbTex, 0);
+    const GLenum fbStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (fbStatus != GL_FRAMEBUFFER_COMPLETE) {
+        logWarning() << "RGB FBO incomplete: 0x" << QmlAV::Hex << fbStatus;
+        cleanup();
+        return false;
+    }
+
+    // Program is built lazily in convert() once the format is known
+    initQuad(ctx->extraFunctions());
+
+    return true;
+}
+
+void QmlAVGLConverter::cleanup()
+{
+    auto *ctx = QOpenGLContext::currentContext();
+    if (ctx) {
+        if (m_fbo) {
+            glDeleteFramebuffers(1, &m_fbo);
+        }
+        if (m_rgbTex) {
+            glDeleteTextures(1, &m_rgbTex);
+        }
+        if (m_vbo) {
+            glDeleteBuffers(1, &m_vbo);
+        }
+        if (m_vao) {
+            if (auto *extra = ctx->extraFunctions()) {
+                extra->glDeleteVertexArrays(1, &m_vao);
+            }
+        }
+        if (m_program) {
+            glDeleteProgram(m_program);
+        }
+    }
+
+    m_fbo = 0;
+    m_rgbTex = 0;
+    m_vbo = 0;
+    m_vao = 0;
+    m_program = 0;
+    m_texLoc[0] = -1;
+    m_texLoc[1] = -1;
+    m_texLoc[2] = -1;
+    m_planeCount = 0;
+    m_bitDepth = 0;
+    m_chromaSwap = false;
+}
+
+GLuint QmlAVGLConverter::convert(int planeCount, int bitDepth, bool chromaSwap)
+{
+    auto *ctx = QOpenGLContext::currentContext();
+    if (!ctx || !isReady()) {
+        return 0;
+    }
+
+    if (!m_program || m_planeCount != planeCount || m_bitDepth != bitDepth || m_chromaSwap != chromaSwap) {
+        // Format changed (e.g. NV12 -> P010): rebuild the shader.
+        GLuint prog = buildProgram(planeCount, bitDepth, chromaSwap);
+        if (!prog) {
+            return 0;
+        }
+        if (m_program) {
+            glDeleteProgram(m_program);
+        }
+        m_program = prog;
+        m_planeCount = planeCount;
+        m_bitDepth = bitDepth;
+        m_chromaSwap = chromaSwap;
+    }
+
+    QOpenGLExtraFunctions *extra = ctx->extraFunctions();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_width, m_height);
+
+    glUseProgram(m_program);
+    for (int i = 0; i < planeCount; ++i) {
+        glUniform1i(m_texLoc[i], i);
+    }
+
+    bindQuad(extra);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    unbindQuad(extra);
+
+    // Detach our FBO before returning the color texture to Qt.
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return m_rgbTex;
+}
+
+void QmlAVGLConverter::setTextureParams()
+{
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+// Compile and link the YUV->RGB shader program. Returns 0 on failure.
+GLuint QmlAVGLConverter::buildProgram(int planeCount, int bitDepth, bool chromaSwap)
+{
+    const std::string vsrc = buildVertexSource(m_coreProfile, m_gles);
+    const std::string fsrc = buildFragmentSource(m_coreProfile, m_gles, planeCount, bitDepth, chromaSwap);
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    const char *vSrc = vsrc.c_str();
+    glShaderSource(vs, 1, &vSrc, nullptr);
+    glCompileShader(vs);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(vs, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        logWarning() << "Failed to compile vertex shader:" << getInfoLog(vs, false).c_str();
+        glDeleteShader(vs);
+        return 0;
+    }
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    const char *fSrc = fsrc.c_str();
+    glShaderSource(fs, 1, &fSrc, nullptr);
+    glCompileShader(fs);
+    glGetShaderiv(fs, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        logWarning() << "Failed to compile fragment shader:" << getInfoLog(fs, false).c_str();
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return 0;
+    }
+
+    GLuint prog = glCreateProgram();
+    glBindAttribLocation(prog, 0, "aPos");
+    glBindAttribLocation(prog, 1, "aTex");
+    glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glLinkProgram(prog);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        logWarning() << "Failed to link YUV->RGB shader:" << getInfoLog(prog, true).c_str();
+        glDeleteProgram(prog);
+        return 0;
+    }
+
+    for (int i = 0; i < planeCount; ++i) {
+        m_texLoc[i] = glGetUniformLocation(prog, ("tex" + std::to_string(i)).c_str());
+    }
+    return prog;
+}
+
+void QmlAVGLConverter::setupAttribs()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
+                          static_cast<GLsizei>(4 * sizeof(GLfloat)), nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE,
+                          static_cast<GLsizei>(4 * sizeof(GLfloat)),
+                          reinterpret_cast<const void *>(static_cast<uintptr_t>(2 * sizeof(GLfloat))));
+}
+
+void QmlAVGLConverter::bindQuad(QOpenGLExtraFunctions *extra)
+{
+    if (extra && m_vao) {
+        extra->glBindVertexArray(m_vao);
+    } else {
+        setupAttribs();
+    }
+}
+
+void QmlAVGLConverter::unbindQuad(QOpenGLExtraFunctions *extra)
+{
+    if (!(extra && m_vao)) {
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+    }
+}
+
+void QmlAVGLConverter::initQuad(QOpenGLExtraFunctions *extra)
+{
+    // NDC (-1,-1) is the FBO's first stored row; v=0 is the top of the video
+    // (DMA-BUF / EGLImage origin, the first row of glTexImage2D data as well).
+    // Qt VideoOutput samples (0,0) at item top-left.
+    static const GLfloat quad[] = {
+        -1.0f, -1.0f, 0.0f, 0.0f,
+         1.0f, -1.0f, 1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f, 1.0f,
+         1.0f,  1.0f, 1.0f, 1.0f
+    };
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(quad)), quad, GL_STATIC_DRAW);
+
+    if (extra) {
+        extra->glGenVertexArrays(1, &m_vao);
+        extra->glBindVertexArray(m_vao);
+        setupAttribs(); // capture the attribute layout into the VAO
+        extra->glBindVertexArray(0);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif
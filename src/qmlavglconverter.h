@@ -0,0 +1,95 @@
+#ifndef QMLAVGLCONVERTER_H
+#define QMLAVGLCONVERTER_H
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+#include <GLES2/gl2.h> // GLuint, GLint, GLenum
+
+class QOpenGLContext;
+class QOpenGLExtraFunctions;
+
+// Isolate our GL traffic from the Qt Quick scene graph.
+// Every capability and binding we touch is saved on construction and restored on destruction;
+// the quad draw depends on blend/depth/scissor/cull being disabled, and Qt needs its own values back.
+class QmlAVGLStateGuard
+{
+public:
+    explicit QmlAVGLStateGuard(QOpenGLContext *ctx);
+    ~QmlAVGLStateGuard();
+
+    QmlAVGLStateGuard(const QmlAVGLStateGuard &other) = delete;
+    QmlAVGLStateGuard &operator=(const QmlAVGLStateGuard &other) = delete;
+
+private:
+    static constexpr int kTextureUnits = 3;
+
+    QOpenGLExtraFunctions *m_extra = nullptr;
+    GLint m_viewport[4] = {};
+    GLint m_fbo = 0;
+    GLint m_program = 0;
+    GLint m_activeTex = 0;
+    GLint m_tex[kTextureUnits] = {};
+    GLint m_arrayBuf = 0;
+    GLint m_elementBuf = 0;
+    GLint m_vao = 0;
+    GLboolean m_caps[4] = {}; // blend, depth test, scissor test, cull face
+};
+
+// Qt5 VideoOutput/GLTextureHandle can only sample an RGB TEXTURE_2D, so the YUV planes are
+// converted on the GPU into a persistent FBO texture. Shared by the outputs that get the planes
+// as textures: imported DMA-BUFs (VAAPI-EGL) or uploaded software frames (GL upload).
+// NOTE: All the methods (but the constructor) require the render thread with a current GL context.
+class QmlAVGLConverter
+{
+public:
+    QmlAVGLConverter() { }
+    ~QmlAVGLConverter() { cleanup(); }
+
+    QmlAVGLConverter(const QmlAVGLConverter &other) = delete;
+    QmlAVGLConverter &operator=(const QmlAVGLConverter &other) = delete;
+
+    bool isReady() const { return m_fbo; }
+    bool isCoreProfile() const { return m_coreProfile; }
+    bool isGLES() const { return m_gles; }
+
+    // Allocates the RGB texture of the frame size and its FBO
+    bool initialize(int width, int height);
+    void cleanup();
+
+    // Draws the plane textures bound to the units 0...planeCount-1 into the RGB texture.
+    // Planes: 1 - RGB, 2 - Y + interleaved UV (VU if chromaSwap), 3 - Y + U + V.
+    // Returns the RGB texture or 0 on failure.
+    GLuint convert(int planeCount, int bitDepth, bool chromaSwap);
+
+    static void setTextureParams();
+
+protected:
+    GLuint buildProgram(int planeCount, int bitDepth, bool chromaSwap);
+    void setupAttribs();
+    void bindQuad(QOpenGLExtraFunctions *extra);
+    void unbindQuad(QOpenGLExtraFunctions *extra);
+    void initQuad(QOpenGLExtraFunctions *extra);
+
+private:
+    bool m_coreProfile = false;
+    bool m_gles = false;
+    int m_width = 0;
+    int m_height = 0;
+
+    GLuint m_program = 0;
+    GLint m_texLoc[3] = {-1, -1, -1}; // Uniform locations for tex0..tex2
+
+    // Shader-relevant format state (for lazy program build / rebuild)
+    int m_planeCount = 0;
+    int m_bitDepth = 0;
+    bool m_chromaSwap = false;
+
+    GLuint m_rgbTex = 0;
+    GLuint m_fbo = 0;
+    GLuint m_vbo = 0;
+    GLuint m_vao = 0;
+};
+
+#endif // __linux__
+
+#endif // QMLAVGLCONVERTER_H
@@ -11,7 +11,8 @@ public:
     {
         TypeUnknown,
         TypeVAAPI_GLX,
-        TypeVAAPI_EGL
+        TypeVAAPI_EGL,
+        TypeGL
     };
 
     struct Contract
@@ -47,6 +48,10 @@ public:
     virtual Type type() const = 0;
     virtual QmlAVPixelFormat pixelFormat() const = 0;
     virtual QAbstractVideoBuffer::HandleType handleType() const = 0;
+    // NOTE: Called outside of the render thread. The unsupported frames take the CPU path.
+    virtual bool isSupported(const QmlAVVideoFrame &videoFrame) const { return videoFrame.isHWDecoded(); }
+    // NOTE: Called outside of the render thread as well, once the frame is going to be presented, ahead of handle()
+    virtual void prepare([[maybe_unused]] const QmlAVVideoFrame &videoFrame) { }
     virtual QVariant handle(const QmlAVVideoFrame &videoFrame) = 0;
 
 protected:
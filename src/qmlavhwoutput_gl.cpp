@@ -0,0 +1,499 @@
+#include "qmlavhwoutput_gl.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#include "qmlavutils.h"
+#include "qmlavglconverter.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include <QOpenGLContext>
+#include <GLES2/gl2.h>
+// GL 3.0/GLES 3.0 tokens not present in GLES2 headers; the context version is checked at runtime.
+#ifndef GL_RED
+#define GL_RED 0x1903
+#endif
+#ifndef GL_RG
+#define GL_RG 0x8227
+#endif
+#ifndef GL_R8
+#define GL_R8 0x8229
+#endif
+#ifndef GL_RG8
+#define GL_RG8 0x822B
+#endif
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER_BINDING
+#define GL_PIXEL_UNPACK_BUFFER_BINDING 0x88EF
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+#include <QOpenGLExtraFunctions>
+
+#define PBO_COUNT 3 // Triple buffering: the GPU may still be reading the previous frame, the next one is being filled
+
+extern "C" {
+#include <libavutil/common.h> // AV_CEIL_RSHIFT
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+
+// Describes how an AV pixel format maps to the uploaded planes and to the shader.
+struct UploadFormat {
+    AVPixelFormat avFormat;
+    int planeCount;  // 2 (semi-planar) or 3 (planar)
+    bool chromaSwap; // NV21-style: UV interleaved as VU
+};
+
+// NOTE: 8-bit only, R16/RG16 textures are not a part of GLES 3.0
+const UploadFormat *findUploadFormat(AVPixelFormat avFormat)
+{
+    static const UploadFormat formats[] = {
+        { AV_PIX_FMT_NV12,    2, false },
+        { AV_PIX_FMT_NV21,    2, true  },
+        { AV_PIX_FMT_YUV420P, 3, false },
+        { AV_PIX_FMT_YUV422P, 3, false },
+        { AV_PIX_FMT_YUV444P, 3, false },
+    };
+
+    for (const UploadFormat &f : formats) {
+        if (f.avFormat == avFormat) {
+            return &f;
+        }
+    }
+    return nullptr;
+}
+
+// Plane offsets in the unpack buffer, the same layout as the frame itself (see QmlAVVideoBuffer::MapData).
+// NOTE: The linesizes are positive, see isSupported()
+struct PlaneLayout {
+    int planeCount = 0;
+    uintptr_t offset[3] = {};
+    GLsizeiptr planeSize[3] = {};
+    GLsizeiptr size = 0;
+};
+
+PlaneLayout planeLayout(const AVFrame *avFrame)
+{
+    PlaneLayout layout;
+
+    const UploadFormat *fmt = findUploadFormat(static_cast<AVPixelFormat>(avFrame->format));
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(avFrame->format));
+    if (!fmt || !desc) {
+        return layout;
+    }
+
+    layout.planeCount = fmt->planeCount;
+    for (int i = 0; i < fmt->planeCount; ++i) {
+        const int height = i > 0 ? AV_CEIL_RSHIFT(avFrame->height, desc->log2_chroma_h) : avFrame->height;
+
+        layout.offset[i] = layout.size;
+        layout.planeSize[i] = static_cast<GLsizeiptr>(avFrame->linesize[i]) * height;
+        layout.size += layout.planeSize[i];
+    }
+
+    return layout;
+}
+
+} // namespace
+
+struct QmlAVHWOutput_GL::Priv
+{
+    QmlAVGLConverter converter;
+    GLuint planeTex[3] = {0, 0, 0};
+    int planeWidth[3] = {};
+    int planeHeight[3] = {};
+    int planeBytes[3] = {}; // Bytes per texel: 1 (R8) or 2 (RG8)
+
+    // Pixel unpack buffer of the ring: mapped by the render thread, filled by the fill thread
+    struct Stage {
+        enum State {
+            Unmapped,
+            Mapped,  // Free
+            Filling, // Owned by the fill thread
+            Filled
+        };
+
+        GLuint pbo = 0;
+        GLsizeiptr size = 0;
+        uint8_t *mapped = nullptr;
+        State state = Unmapped;
+        AVFramePtr avFrame; // Filling or filled with
+        uint64_t order = 0; // Of the fill, the oldest filled one is reused first
+    };
+
+    // Everything below is guarded by stageMutex, the GL calls are made by the render thread only
+    std::mutex stageMutex;
+    std::condition_variable stageCond;
+    Stage stages[PBO_COUNT];
+    uint64_t fillCount = 0;
+};
+
+QmlAVHWOutput_GL::QmlAVHWOutput_GL()
+    : m_gl(std::make_unique<Priv>())
+    , m_unavailable(false)
+    , m_fillTask(&QmlAVHWOutput_GL::fill)
+{
+    // NOTE: The copies are short, they don't need a dedicated thread
+    m_fillThread = m_fillTask.getLiveController(QmlAVWorkerThread::Pooled);
+}
+
+QmlAVHWOutput_GL::~QmlAVHWOutput_GL()
+{
+    cleanupGL();
+}
+
+bool QmlAVHWOutput_GL::isSupported(const QmlAVVideoFrame &videoFrame) const
+{
+    if (m_unavailable || videoFrame.isHWDecoded() || !findUploadFormat(videoFrame.pixelFormat())) {
+        return false;
+    }
+
+    // GL_UNPACK_ROW_LENGTH can't walk the rows bottom-up (e.g. of vertically flipped frames), the CPU path converts them
+    const AVFramePtr &avFrame = videoFrame.avFrame();
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && avFrame->data[i]; ++i) {
+        if (avFrame->linesize[i] <= 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Starts copying the frame into a mapped buffer of the ring. If there is none, the frame is uploaded
+// from the client memory by the render thread itself. A filled buffer of a frame that has been superseded
+// before the render (e.g. by a newer frame) is reused.
+void QmlAVHWOutput_GL::prepare(const QmlAVVideoFrame &videoFrame)
+{
+    if (!isSupported(videoFrame)) {
+        return;
+    }
+
+    const AVFramePtr &avFrame = videoFrame.avFrame();
+    const PlaneLayout layout = planeLayout(avFrame);
+
+    int index = -1;
+
+    {
+        std::scoped_lock lock(m_gl->stageMutex);
+
+        for (int i = 0; i < PBO_COUNT && index < 0; ++i) {
+            const auto &stage = m_gl->stages[i];
+            if (stage.state == Priv::Stage::Mapped && stage.size >= layout.size) {
+                index = i;
+            }
+        }
+        for (int i = 0; i < PBO_COUNT && index < 0; ++i) {
+            const auto &stage = m_gl->stages[i];
+            if (stage.state == Priv::Stage::Filled && stage.size >= layout.size
+                    && (index < 0 || stage.order < m_gl->stages[index].order)) {
+                index = i;
+            }
+        }
+
+        if (index < 0) {
+            return;
+        }
+
+        auto &stage = m_gl->stages[index];
+        stage.state = Priv::Stage::Filling;
+        stage.avFrame = avFrame;
+        stage.order = ++m_gl->fillCount;
+    }
+
+    m_fillTask(this, index, avFrame);
+}
+
+// NOTE: Executes in the fill thread context
+void QmlAVHWOutput_GL::fill(int index, const AVFramePtr &avFrame)
+{
+    const PlaneLayout layout = planeLayout(avFrame);
+    uint8_t *mapped = nullptr;
+
+    {
+        std::scoped_lock lock(m_gl->stageMutex);
+        mapped = m_gl->stages[index].mapped;
+    }
+
+    // The buffer stays mapped as long as it is being filled, see takeStagedFrame() and cleanupGL()
+    for (int i = 0; i < layout.planeCount; ++i) {
+        memcpy(mapped + layout.offset[i], avFrame->data[i], layout.planeSize[i]);
+    }
+
+    // NOTE: Notified under the lock, the waiting cleanupGL() may destroy the condition right after
+    std::scoped_lock lock(m_gl->stageMutex);
+    m_gl->stages[index].state = Priv::Stage::Filled;
+    m_gl->stageCond.notify_all();
+}
+
+QVariant QmlAVHWOutput_GL::handle(const QmlAVVideoFrame &videoFrame)
+{
+    if (!videoFrame.isValid() || videoFrame.isHWDecoded()) {
+        return {};
+    }
+
+    const UploadFormat *fmt = findUploadFormat(videoFrame.pixelFormat());
+    if (!fmt) {
+        logWarning() << "GL: unsupported pixel format " << videoFrame.pixelFormat();
+        return {};
+    }
+
+    auto *ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        logWarning() << "No current OpenGL context.";
+        return {};
+    }
+
+    Contract newContract(videoFrame);
+    if (m_contract != newContract) {
+        m_contract = newContract;
+        cleanupGL();
+    }
+
+    // Capture Qt Quick state *before* any of our GL calls, including init.
+    QmlAVGLStateGuard state(ctx);
+
+    if (!m_gl->converter.isReady() && !initializeGL(videoFrame)) {
+        return {};
+    }
+
+    // The unpack state is not a part of the guard, Qt expects the defaults back
+    GLint unpackAlignment = 4;
+    GLint unpackRowLength = 0;
+    GLint unpackBuffer = 0;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &unpackRowLength);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    uploadPlanes(videoFrame, fmt->planeCount);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(unpackBuffer));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, unpackRowLength);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+    GLuint rgbTex = m_gl->converter.convert(fmt->planeCount, 8, fmt->chromaSwap);
+    if (!rgbTex) {
+        return {};
+    }
+
+    return rgbTex;
+}
+
+// A glTexSubImage2D() from the client memory blocks until the driver has copied the whole frame.
+// From a pixel unpack buffer it only queues a DMA transfer, the frame has been copied into the buffer
+// by the fill thread meanwhile (see prepare()). The frames that have not been staged in time are uploaded
+// from the client memory.
+void QmlAVHWOutput_GL::uploadPlanes(const QmlAVVideoFrame &videoFrame, int planeCount)
+{
+    const AVFramePtr &avFrame = videoFrame.avFrame();
+    auto *extra = QOpenGLContext::currentContext()->extraFunctions();
+    const PlaneLayout layout = planeLayout(avFrame);
+
+    bool staged = false;
+    int index = takeStagedFrame(avFrame);
+    if (index >= 0 && extra) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_gl->stages[index].pbo);
+
+        // The contents may be lost (e.g. the display mode has changed)
+        staged = extra->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        if (!staged) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+    }
+
+    for (int i = 0; i < planeCount; ++i) {
+        const int bytes = m_gl->planeBytes[i];
+        // NOTE: With a bound unpack buffer the "pixels" argument is an offset into it
+        const void *pixels = staged ? reinterpret_cast<const void *>(layout.offset[i]) : avFrame->data[i];
+
+        glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
+        glBindTexture(GL_TEXTURE_2D, m_gl->planeTex[i]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, avFrame->linesize[i] / bytes);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_gl->planeWidth[i], m_gl->planeHeight[i],
+                        bytes == 2 ? GL_RG : GL_RED, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    // The next frames are staged with the same layout
+    if (extra) {
+        mapStages(avFrame);
+    }
+}
+
+// Takes the buffer the frame has been copied into, if any. The copy in progress is waited for,
+// it has been started ahead and is about to complete. The taken buffer is left for the caller to unmap.
+int QmlAVHWOutput_GL::takeStagedFrame(const AVFramePtr &avFrame)
+{
+    std::unique_lock<std::mutex> lock(m_gl->stageMutex);
+
+    for (;;) {
+        int index = -1;
+        for (int i = 0; i < PBO_COUNT; ++i) {
+            const auto &stage = m_gl->stages[i];
+            if ((stage.state == Priv::Stage::Filling || stage.state == Priv::Stage::Filled)
+                    && stage.avFrame->data[0] == avFrame->data[0]) {
+                index = i;
+                break;
+            }
+        }
+
+        if (index < 0) {
+            return -1;
+        }
+
+        auto &stage = m_gl->stages[index];
+        if (stage.state == Priv::Stage::Filled) {
+            stage.state = Priv::Stage::Unmapped;
+            stage.mapped = nullptr;
+            stage.avFrame.unref();
+            return index;
+        }
+
+        m_gl->stageCond.wait(lock);
+    }
+}
+
+// Maps the free buffers of the ring for the fill thread, write-only: the previous contents are discarded
+// and the driver doesn't wait for the GPU still reading them
+void QmlAVHWOutput_GL::mapStages(const AVFramePtr &avFrame)
+{
+    auto *extra = QOpenGLContext::currentContext()->extraFunctions();
+    const GLsizeiptr size = planeLayout(avFrame).size;
+
+    for (auto &stage : m_gl->stages) {
+        {
+            // NOTE: Only the render thread leaves the unmapped state
+            std::scoped_lock lock(m_gl->stageMutex);
+            if (stage.state != Priv::Stage::Unmapped) {
+                continue;
+            }
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stage.pbo);
+        if (stage.size != size) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        }
+
+        auto *mapped = static_cast<uint8_t *>(extra->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+        std::scoped_lock lock(m_gl->stageMutex);
+        stage.size = size;
+        stage.mapped = mapped;
+        stage.state = mapped ? Priv::Stage::Mapped : Priv::Stage::Unmapped;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+bool QmlAVHWOutput_GL::initializeGL(const QmlAVVideoFrame &videoFrame)
+{
+    auto *ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        return false;
+    }
+
+    if (ctx->format().majorVersion() < 3) {
+        logWarning() << "The \"gl\" output module requires OpenGL 3.0 or OpenGL ES 3.0. Falling back to the CPU conversion.";
+        m_unavailable = true;
+        return false;
+    }
+
+    const UploadFormat *fmt = findUploadFormat(videoFrame.pixelFormat());
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(videoFrame.pixelFormat());
+    if (!fmt || !desc) {
+        return false;
+    }
+
+    // The shader program is built lazily on the first conversion
+    if (!m_gl->converter.initialize(videoFrame.width(), videoFrame.height())) {
+        cleanupGL();
+        return false;
+    }
+
+    // Immutable plane sizes for the contract lifetime, the frames only update the contents
+    glGenTextures(3, m_gl->planeTex);
+    for (int i = 0; i < fmt->planeCount; ++i) {
+        const bool chroma = i > 0;
+        const int bytes = fmt->planeCount == 2 && chroma ? 2 : 1;
+
+        m_gl->planeWidth[i] = chroma ? AV_CEIL_RSHIFT(videoFrame.width(), desc->log2_chroma_w) : videoFrame.width();
+        m_gl->planeHeight[i] = chroma ? AV_CEIL_RSHIFT(videoFrame.height(), desc->log2_chroma_h) : videoFrame.height();
+        m_gl->planeBytes[i] = bytes;
+
+        glBindTexture(GL_TEXTURE_2D, m_gl->planeTex[i]);
+        QmlAVGLConverter::setTextureParams();
+        glTexImage2D(GL_TEXTURE_2D, 0, bytes == 2 ? GL_RG8 : GL_R8, m_gl->planeWidth[i], m_gl->planeHeight[i], 0,
+                     bytes == 2 ? GL_RG : GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // The storage is allocated on the first upload, when the line sizes are known
+    GLuint pbo[PBO_COUNT] = {};
+    glGenBuffers(PBO_COUNT, pbo);
+    for (int i = 0; i < PBO_COUNT; ++i) {
+        m_gl->stages[i].pbo = pbo[i];
+    }
+
+    return true;
+}
+
+void QmlAVHWOutput_GL::cleanupGL()
+{
+    m_gl->converter.cleanup();
+
+    auto *ctx = QOpenGLContext::currentContext();
+    if (ctx && (m_gl->planeTex[0] || m_gl->planeTex[1] || m_gl->planeTex[2])) {
+        glDeleteTextures(3, m_gl->planeTex);
+    }
+
+    {
+        // The fill thread writes into the mapped buffer until it is done
+        std::unique_lock<std::mutex> lock(m_gl->stageMutex);
+        m_gl->stageCond.wait(lock, [&] {
+            // Executes in lock context
+            return std::none_of(std::begin(m_gl->stages), std::end(m_gl->stages), [](const auto &stage) {
+                return stage.state == Priv::Stage::Filling;
+            });
+        });
+
+        auto *extra = ctx ? ctx->extraFunctions() : nullptr;
+        for (auto &stage : m_gl->stages) {
+            if (stage.pbo && ctx) {
+                if (stage.mapped && extra) {
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stage.pbo);
+                    extra->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                }
+                glDeleteBuffers(1, &stage.pbo);
+            }
+
+            stage.pbo = 0;
+            stage.size = 0;
+            stage.mapped = nullptr;
+            stage.state = Priv::Stage::Unmapped;
+            stage.avFrame.unref();
+        }
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        m_gl->planeTex[i] = 0;
+        m_gl->planeWidth[i] = 0;
+        m_gl->planeHeight[i] = 0;
+        m_gl->planeBytes[i] = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef QMLAVHWOUTPUT_GL_H
+#define QMLAVHWOUTPUT_GL_H
+
+#include "qmlavhwoutput.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+#include <atomic>
+#include <memory>
+
+#include "qmlavthread.h"
+
+// Software-decoded frames → plane textures → GL.
+// The planes are uploaded as is and converted to RGB on the GPU by the same shader as the VAAPI-EGL output,
+// so non-Qt-native formats don't go through swscale on the CPU. Requires GL 3.0 or GLES 3.0 (R8/RG8 textures).
+// The render thread keeps a ring of pixel unpack buffers mapped, a pooled thread copies the frames into them
+// as soon as they are going to be presented (see prepare()). The render thread only unmaps the buffer then
+// and queues its transfer to the textures.
+class QmlAVHWOutput_GL final : public QmlAVHWOutput
+{
+public:
+    QmlAVHWOutput_GL();
+    ~QmlAVHWOutput_GL() override;
+
+    Type type() const override { return TypeGL; }
+    QmlAVPixelFormat pixelFormat() const override { return AV_PIX_FMT_BGR32; }
+    QAbstractVideoBuffer::HandleType handleType() const override { return QAbstractVideoBuffer::GLTextureHandle; }
+    bool isSupported(const QmlAVVideoFrame &videoFrame) const override;
+    void prepare(const QmlAVVideoFrame &videoFrame) override;
+    QVariant handle(const QmlAVVideoFrame &videoFrame) override;
+
+protected:
+    void fill(int index, const AVFramePtr &avFrame);
+
+private:
+    struct Priv;
+    std::unique_ptr<Priv> m_gl;
+
+    // Set by the render thread when the GL context can't do the job, the frames take the CPU path then
+    std::atomic<bool> m_unavailable;
+
+    QmlAVThreadTask<decltype(&QmlAVHWOutput_GL::fill)> m_fillTask;
+    QmlAVThreadLiveController<void> m_fillThread;
+
+    bool initializeGL(const QmlAVVideoFrame &videoFrame);
+    void uploadPlanes(const QmlAVVideoFrame &videoFrame, int planeCount);
+    int takeStagedFrame(const AVFramePtr &avFrame);
+    void mapStages(const AVFramePtr &avFrame);
+    void cleanupGL();
+};
+
+#endif // __linux__
+
+#endif // QMLAVHWOUTPUT_GL_H
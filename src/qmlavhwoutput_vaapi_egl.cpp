@@ -2,27 +2,18 @@
 
 #if defined(__linux__) && !defined(__ANDROID__)
 #include "qmlavutils.h"
+#include "qmlavglconverter.h"
 
 #include <cstdint>
 #include <cstring>
-#include <string>
 #include <unistd.h>
 
 #include <QOpenGLContext>
 // Raw GL entry points are used only for the GL 1.0/1.1 core
 // (glGetIntegerv, glBindTexture, glViewport, ...), which <GL/gl.h>
-// declares on every platform — same as the GLX output does. Everything
-// above GL 1.1 (buffers, FBOs, VAOs, shaders, attrib arrays) lives in
-// <GL/glext.h>, which is not reliably available with prototypes, so it
-// stays on QOpenGLExtraFunctions (VAO).
+// declares on every platform — same as the GLX output does. The shader
+// program, FBO and quad live in QmlAVGLConverter.
 #include <GLES2/gl2.h>
-// GL_RGBA8 is a desktop-GL token not present in GLES2 headers; the desktop
-// internal format is selected at runtime, so a fallback is enough for the
-// build (the GLES path never uses it).
-#ifndef GL_RGBA8
-#define GL_RGBA8 GL_RGBA
-#endif
-#include <QOpenGLExtraFunctions>
 
 // Prevent eglplatform.h from pulling X11 macros (None/Status) into this TU.
 #ifndef EGL_NO_X11
@@ -236,182 +227,6 @@ bool hasEglExt(const char *exts, const char *name)
     return exts && std::strstr(exts, name);
 }
 
-// ---------------------------------------------------------------------------
-// Shader sources (single body, parametrized for GLES / legacy GL / core GL)
-// ---------------------------------------------------------------------------
-
-std::string buildVertexSource(bool core, bool gles)
-{
-    std::string src;
-    if (core) {
-        src = "#version 150\n";
-    } else if (!gles) {
-        src = "#version 120\n";
-    }
-    if (core) {
-        src += "in vec2 aPos;\n"
-               "in vec2 aTex;\n"
-               "out vec2 vTex;\n"
-               "void main() {\n"
-               "    gl_Position = vec4(aPos, 0.0, 1.0);\n"
-               "    vTex = aTex;\n"
-               "}\n";
-    } else {
-        // GLES 2.0 has no explicit version line (ES 1.00 default).
-        src += "attribute vec2 aPos;\n"
-               "attribute vec2 aTex;\n"
-               "varying vec2 vTex;\n"
-               "void main() {\n"
-               "    gl_Position = vec4(aPos, 0.0, 1.0);\n"
-               "    vTex = aTex;\n"
-               "}\n";
-    }
-    return src;
-}
-
-// Build a YUV->RGB fragment shader for `fmt` (1/2/3 planes, 8/10/16-bit).
-// The matrix is BT.601 limited-range (the MVP's fixed behavior); colorspace
-// handling (BT.709/2020, full range) is a separate step.
-std::string buildFragmentSource(bool core, bool gles, const PlaneFormat &fmt)
-{
-    std::string src;
-    if (core) {
-        src = "#version 150\n";
-    } else if (gles) {
-        // `precision` is a keyword only in GLSL ES, never on desktop GL.
-        src = "precision mediump float;\n";
-    } else {
-        src = "#version 120\n";
-    }
-
-    // Sampler declarations: tex0..texN.
-    for (int i = 0; i < fmt.planeCount; ++i) {
-        src += "uniform sampler2D tex" + std::to_string(i) + ";\n";
-    }
-    if (core) {
-        src += "in vec2 vTex;\n"
-               "out vec4 fragColor;\n";
-    } else {
-        src += "varying vec2 vTex;\n";
-    }
-    const std::string sample = core ? std::string("texture") : std::string("texture2D");
-    const std::string out = core ? std::string("fragColor") : std::string("gl_FragColor");
-
-    // Normalization: GL maps integer textures to [0,1] by dividing by 65535
-    // (for R16/GR1616). P010 stores 10 significant bits in the HIGH bits of a
-    // 16-bit word, so the sampled value is v10*64/65535; scale back to v10/1023.
-    // P016 uses the full 16 bits, so GL's own normalization is already correct.
-    const char *yScale = "1.0";
-    const char *uvScale = "1.0";
-    if (fmt.bitDepth == 10) {
-        // sampled = v10 * 64 / 65535  ->  multiply by 65535/(64*1023) ~= 1.00096
-        yScale = "65535.0 / 65472.0";
-        uvScale = "65535.0 / 65472.0";
-    }
-
-    src += "void main() {\n";
-    if (fmt.planeCount == 1) {
-        // RGB passthrough.
-        src += "    " + out + " = vec4(" + sample + "(tex0, vTex).rgb, 1.0);\n";
-    } else if (fmt.planeCount == 2) {
-        // Semi-planar: tex0 = Y, tex1 = interleaved UV (or VU for NV21).
-        src += "    float y = " + sample + "(tex0, vTex).r * " + yScale + ";\n"
-               "    vec2 uv = " + sample + "(tex1, vTex).rg;\n";
-        if (fmt.chromaSwap) {
-            src += "    uv = uv.yx;\n";
-        }
-        src += "    uv -= vec2(0.5);\n"
-               "    y = (y - 0.062745) * 1.164;\n"
-               "    " + out + " = vec4(y + 1.596 * uv.y,\n"
-               "                     y - 0.391 * uv.x - 0.813 * uv.y,\n"
-               "                     y + 2.018 * uv.x, 1.0);\n";
-    } else {
-        // Planar: tex0 = Y, tex1 = U, tex2 = V.
-        src += "    float y = " + sample + "(tex0, vTex).r * " + yScale + ";\n"
-               "    float u = " + sample + "(tex1, vTex).r * " + uvScale + " - 0.5;\n"
-               "    float v = " + sample + "(tex2, vTex).r * " + uvScale + " - 0.5;\n"
-               "    y = (y - 0.062745) * 1.164;\n"
-               "    " + out + " = vec4(y + 1.596 * v,\n"
-               "                     y - 0.391 * u - 0.813 * v,\n"
-               "                     y + 2.018 * u, 1.0);\n";
-    }
-    src += "}\n";
-    return src;
-}
-
-// Isolate our GL traffic from the Qt Quick scene graph.
-// The previous version saved state *after* FBO creation and restored our FBO
-// on the way out; Qt then sampled that same texture while it was still the
-// color attachment — Mesa crashes in glDrawElements (feedback loop).
-// Every capability we touch is saved/restored; the quad draw depends on
-// blend/depth/scissor/cull being disabled, and Qt needs its own values back.
-struct GLStateGuard {
-    QOpenGLExtraFunctions *extra = nullptr;
-    GLint viewport[4] = {};
-    GLint fbo = 0;
-    GLint program = 0;
-    GLint activeTex = 0;
-    GLint tex[2] = {0, 0};
-    GLint arrayBuf = 0;
-    GLint elementBuf = 0;
-    GLint vao = 0;
-    GLboolean caps[4] = {}; // blend, depth test, scissor test, cull face
-
-    static constexpr GLenum kCaps[4] = {GL_BLEND, GL_DEPTH_TEST, GL_SCISSOR_TEST, GL_CULL_FACE};
-
-    explicit GLStateGuard(QOpenGLContext *ctx)
-        : extra(ctx->extraFunctions())
-    {
-        glGetIntegerv(GL_VIEWPORT, viewport);
-        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
-        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
-        glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &arrayBuf);
-        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuf);
-        if (extra) {
-            extra->glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
-        }
-
-        for (int i = 0; i < 4; ++i) {
-            caps[i] = glIsEnabled(kCaps[i]);
-            glDisable(kCaps[i]);
-        }
-
-        glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTex);
-        for (int i = 0; i < 2; ++i) {
-            glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
-            glGetIntegerv(GL_TEXTURE_BINDING_2D, &tex[i]);
-        }
-    }
-
-    ~GLStateGuard()
-    {
-        for (int i = 0; i < 4; ++i) {
-            if (caps[i]) {
-                glEnable(kCaps[i]);
-            }
-        }
-
-        // VAO first: element-array binding lives in the VAO.
-        if (extra) {
-            extra->glBindVertexArray(static_cast<GLuint>(vao));
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(arrayBuf));
-        if (!extra || vao == 0) {
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLuint>(elementBuf));
-        }
-        glUseProgram(static_cast<GLuint>(program));
-
-        for (int i = 0; i < 2; ++i) {
-            glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
-            glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(tex[i]));
-        }
-        glActiveTexture(static_cast<GLenum>(activeTex));
-
-        glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(fbo));
-        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
-    }
-};
-
 } // namespace
 
 struct QmlAVHWOutput_VAAPI_EGL::Priv
@@ -424,20 +239,8 @@ struct QmlAVHWOutput_VAAPI_EGL::Priv
     PFNEGLDESTROYIMAGEKHRPROC destroyImage = nullptr;
     PFNGLEGLIMAGETARGETTEXTURE2DOESPROC imageTargetTexture2D = nullptr;
 
-    GLuint program = 0;
-    GLint texLoc[3] = {-1, -1, -1}; // uniform locations for tex0..tex2
-
-    // Shader-relevant format state (for lazy program build / rebuild).
-    int planeCount = 0;
-    int bitDepth = 0;
-    bool coreProfile = false;
-    bool gles = false;
-
-    GLuint rgbTex = 0;
-    GLuint fbo = 0;
+    QmlAVGLConverter converter;
     GLuint planeTex[3] = {0, 0, 0};
-    GLuint vbo = 0;
-    GLuint vao = 0;
 };
 
 QmlAVHWOutput_VAAPI_EGL::QmlAVHWOutput_VAAPI_EGL()
@@ -487,7 +290,7 @@ QVariant QmlAVHWOutput_VAAPI_EGL::handle(const QmlAVVideoFrame &videoFrame)
     }
 
     // Capture Qt Quick state *before* any of our GL calls, including init.
-    GLStateGuard state(ctx);
+    QmlAVGLStateGuard state(ctx);
 
     // RGB formats need no conversion: return the single plane texture directly.
     if (fmt->isRgb) {
@@ -514,7 +317,7 @@ QVariant QmlAVHWOutput_VAAPI_EGL::handle(const QmlAVVideoFrame &videoFrame)
 
         // Bind the EGLImage to a plane texture and hand it to Qt directly.
         glBindTexture(GL_TEXTURE_2D, m_egl->planeTex[0]);
-        setTextureParams();
+        QmlAVGLConverter::setTextureParams();
         m_egl->imageTargetTexture2D(GL_TEXTURE_2D, image);
         m_egl->destroyImage(m_egl->display, image);
         return static_cast<QVariant>(m_egl->planeTex[0]);
@@ -525,24 +328,6 @@ QVariant QmlAVHWOutput_VAAPI_EGL::handle(const QmlAVVideoFrame &videoFrame)
             return {};
         }
     }
-    if (!m_egl->program) {
-        m_egl->program = buildProgram(m_egl->coreProfile, m_egl->gles, fmt->planeCount, fmt->bitDepth, fmt->chromaSwap);
-        if (!m_egl->program) {
-            return {};
-        }
-        m_egl->planeCount = fmt->planeCount;
-        m_egl->bitDepth = fmt->bitDepth;
-    } else if (m_egl->planeCount != fmt->planeCount || m_egl->bitDepth != fmt->bitDepth) {
-        // Format changed (e.g. NV12 -> P010): rebuild the shader.
-        GLuint prog = buildProgram(m_egl->coreProfile, m_egl->gles, fmt->planeCount, fmt->bitDepth, fmt->chromaSwap);
-        if (!prog) {
-            return {};
-        }
-        glDeleteProgram(m_egl->program);
-        m_egl->program = prog;
-        m_egl->planeCount = fmt->planeCount;
-        m_egl->bitDepth = fmt->bitDepth;
-    }
 
     vaSyncSurface(vaDisplay, vaSurface);
 
@@ -561,8 +346,6 @@ QVariant QmlAVHWOutput_VAAPI_EGL::handle(const QmlAVVideoFrame &videoFrame)
         return {};
     }
 
-    QOpenGLExtraFunctions *extra = ctx->extraFunctions();
-
     EGLImageKHR images[3] = {};
     bool ok = true;
 
@@ -578,25 +361,14 @@ QVariant QmlAVHWOutput_VAAPI_EGL::handle(const QmlAVVideoFrame &videoFrame)
 
         glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + i));
         glBindTexture(GL_TEXTURE_2D, m_egl->planeTex[i]);
-        setTextureParams();
+        QmlAVGLConverter::setTextureParams();
         m_egl->imageTargetTexture2D(GL_TEXTURE_2D, images[i]);
     }
 
+    GLuint rgbTex = 0;
     if (ok) {
-        glBindFramebuffer(GL_FRAMEBUFFER, m_egl->fbo);
-        glViewport(0, 0, videoFrame.width(), videoFrame.height());
-
-        glUseProgram(m_egl->program);
-        for (int i = 0; i < fmt->planeCount; ++i) {
-            glUniform1i(m_egl->texLoc[i], i);
-        }
-
-        bindQuad(extra);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        unbindQuad(extra);
-
-        // Detach our FBO before returning the color texture to Qt.
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        rgbTex = m_egl->converter.convert(fmt->planeCount, fmt->bitDepth, fmt->chromaSwap);
+        ok = rgbTex;
     }
 
     for (EGLImageKHR image : images) {
@@ -609,79 +381,7 @@ QVariant QmlAVHWOutput_VAAPI_EGL::handle(const QmlAVVideoFrame &videoFrame)
         return {};
     }
 
-    return m_egl->rgbTex;
-}
-
-static std::string getInfoLog(GLuint obj, bool isProgram)
-{
-    GLint len = 0;
-    if (isProgram) {
-        glGetProgramiv(obj, GL_INFO_LOG_LENGTH, &len);
-    } else {
-        glGetShaderiv(obj, GL_INFO_LOG_LENGTH, &len);
-    }
-    if (len <= 1) {
-        return {};
-    }
-    std::string log(static_cast<size_t>(len - 1), '\0');
-    if (isProgram) {
-        glGetProgramInfoLog(obj, len, nullptr, log.data());
-    } else {
-        glGetShaderInfoLog(obj, len, nullptr, log.data());
-    }
-    return log;
-}
-
-// Compile and link the YUV->RGB shader program. Returns 0 on failure.
-GLuint QmlAVHWOutput_VAAPI_EGL::buildProgram(bool core, bool gles, int planeCount, int bitDepth, bool chromaSwap)
-{
-    const PlaneFormat fmt{ AV_PIX_FMT_NONE, planeCount, {}, bitDepth, chromaSwap, false };
-    const std::string vsrc = buildVertexSource(core, gles);
-    const std::string fsrc = buildFragmentSource(core, gles, fmt);
-
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    const char *vSrc = vsrc.c_str();
-    glShaderSource(vs, 1, &vSrc, nullptr);
-    glCompileShader(vs);
-    GLint ok = GL_FALSE;
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &ok);
-    if (!ok) {
-        logWarning() << "Failed to compile vertex shader:" << getInfoLog(vs, false).c_str();
-        glDeleteShader(vs);
-        return 0;
-    }
-
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    const char *fSrc = fsrc.c_str();
-    glShaderSource(fs, 1, &fSrc, nullptr);
-    glCompileShader(fs);
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &ok);
-    if (!ok) {
-        logWarning() << "Failed to compile fragment shader:" << getInfoLog(fs, false).c_str();
-        glDeleteShader(vs);
-        glDeleteShader(fs);
-        return 0;
-    }
-
-    GLuint prog = glCreateProgram();
-    glBindAttribLocation(prog, 0, "aPos");
-    glBindAttribLocation(prog, 1, "aTex");
-    glAttachShader(prog, vs);
-    glAttachShader(prog, fs);
-    glLinkProgram(prog);
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
-    if (!ok) {
-        logWarning() << "Failed to link YUV->RGB shader:" << getInfoLog(prog, true).c_str();
-        glDeleteProgram(prog);
-        return 0;
-    }
-
-    for (int i = 0; i < fmt.planeCount; ++i) {
-        m_egl->texLoc[i] = glGetUniformLocation(prog, ("tex" + std::to_string(i)).c_str());
-    }
-    return prog;
+    return rgbTex;
 }
 
 bool QmlAVHWOutput_VAAPI_EGL::initializeEGL(int width, int height)
@@ -717,35 +417,14 @@ bool QmlAVHWOutput_VAAPI_EGL::initializeEGL(int width, int height)
     m_egl->display = dpy;
     m_egl->hasModifiers = hasEglExt(exts, "EGL_EXT_image_dma_buf_import_modifiers");
 
-    const bool gles = ctx->isOpenGLES();
-    const bool core = !gles && ctx->format().profile() == QSurfaceFormat::CoreProfile;
-    m_egl->coreProfile = core;
-    m_egl->gles = gles;
-
-    // Program is built lazily in handle() once the format is known; for the
-    // RGB path no program is needed at all.
-    m_egl->program = 0;
-
-    glGenTextures(1, &m_egl->rgbTex);
-    glBindTexture(GL_TEXTURE_2D, m_egl->rgbTex);
-    setTextureParams();
-    glTexImage2D(GL_TEXTURE_2D, 0, gles ? GL_RGBA : GL_RGBA8,
-                    width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-
-    glGenFramebuffers(1, &m_egl->fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_egl->fbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                              GL_TEXTURE_2D, m_egl->rgbTex, 0);
-    const GLenum fbStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    if (fbStatus != GL_FRAMEBUFFER_COMPLETE) {
-        logWarning() << "RGB FBO incomplete: 0x" << QmlAV::Hex << fbStatus;
+    // The shader program is built lazily on the first conversion once the format is known;
+    // for the RGB path no program is needed at all.
+    if (!m_egl->converter.initialize(width, height)) {
         cleanupEGL();
         return false;
     }
 
     glGenTextures(3, m_egl->planeTex);
-    initQuad(ctx->extraFunctions());
 
     m_egl->ready = true;
     return true;
@@ -753,51 +432,16 @@ bool QmlAVHWOutput_VAAPI_EGL::initializeEGL(int width, int height)
 
 void QmlAVHWOutput_VAAPI_EGL::cleanupEGL()
 {
+    m_egl->converter.cleanup();
+
     auto *ctx = QOpenGLContext::currentContext();
-    if (ctx) {
-        if (m_egl->fbo) {
-            glDeleteFramebuffers(1, &m_egl->fbo);
-            m_egl->fbo = 0;
-        }
-        if (m_egl->rgbTex) {
-            glDeleteTextures(1, &m_egl->rgbTex);
-            m_egl->rgbTex = 0;
-        }
-        if (m_egl->vbo) {
-            glDeleteBuffers(1, &m_egl->vbo);
-            m_egl->vbo = 0;
-        }
-        if (m_egl->planeTex[0] || m_egl->planeTex[1] || m_egl->planeTex[2]) {
-            glDeleteTextures(3, m_egl->planeTex);
-            m_egl->planeTex[0] = 0;
-            m_egl->planeTex[1] = 0;
-            m_egl->planeTex[2] = 0;
-        }
-        if (m_egl->vao) {
-            if (auto *extra = ctx->extraFunctions()) {
-                extra->glDeleteVertexArrays(1, &m_egl->vao);
-            }
-            m_egl->vao = 0;
-        }
-    } else {
-        m_egl->fbo = 0;
-        m_egl->rgbTex = 0;
-        m_egl->vbo = 0;
-        m_egl->planeTex[0] = 0;
-        m_egl->planeTex[1] = 0;
-        m_egl->planeTex[2] = 0;
-        m_egl->vao = 0;
+    if (ctx && (m_egl->planeTex[0] || m_egl->planeTex[1] || m_egl->planeTex[2])) {
+        glDeleteTextures(3, m_egl->planeTex);
     }
+    m_egl->planeTex[0] = 0;
+    m_egl->planeTex[1] = 0;
+    m_egl->planeTex[2] = 0;
 
-    if (m_egl->program) {
-        glDeleteProgram(m_egl->program);
-    }
-    m_egl->program = 0;
-    m_egl->texLoc[0] = -1;
-    m_egl->texLoc[1] = -1;
-    m_egl->texLoc[2] = -1;
-    m_egl->planeCount = 0;
-    m_egl->bitDepth = 0;
     m_egl->display = nullptr;
     m_egl->hasModifiers = false;
     m_egl->ready = false;
@@ -806,66 +450,4 @@ void QmlAVHWOutput_VAAPI_EGL::cleanupEGL()
     m_egl->imageTargetTexture2D = nullptr;
 }
 
-void QmlAVHWOutput_VAAPI_EGL::setTextureParams()
-{
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-}
-
-void QmlAVHWOutput_VAAPI_EGL::setupAttribs()
-{
-    glBindBuffer(GL_ARRAY_BUFFER, m_egl->vbo);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE,
-                             static_cast<GLsizei>(4 * sizeof(GLfloat)), nullptr);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE,
-                             static_cast<GLsizei>(4 * sizeof(GLfloat)),
-                             reinterpret_cast<const void *>(static_cast<uintptr_t>(2 * sizeof(GLfloat))));
-}
-
-void QmlAVHWOutput_VAAPI_EGL::bindQuad(QOpenGLExtraFunctions *extra)
-{
-    if (extra && m_egl->vao) {
-        extra->glBindVertexArray(m_egl->vao);
-    } else {
-        setupAttribs();
-    }
-}
-
-void QmlAVHWOutput_VAAPI_EGL::unbindQuad(QOpenGLExtraFunctions *extra)
-{
-    if (!(extra && m_egl->vao)) {
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-    }
-}
-
-void QmlAVHWOutput_VAAPI_EGL::initQuad(QOpenGLExtraFunctions *extra)
-{
-    // NDC (-1,-1) is the FBO's first stored row; v=0 is the top of the video
-    // (DMA-BUF / EGLImage origin). Qt VideoOutput samples (0,0) at item top-left.
-    static const GLfloat quad[] = {
-        -1.0f, -1.0f, 0.0f, 0.0f,
-         1.0f, -1.0f, 1.0f, 0.0f,
-        -1.0f,  1.0f, 0.0f, 1.0f,
-         1.0f,  1.0f, 1.0f, 1.0f
-    };
-
-    glGenBuffers(1, &m_egl->vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, m_egl->vbo);
-    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(quad)), quad, GL_STATIC_DRAW);
-
-    if (extra) {
-        extra->glGenVertexArrays(1, &m_egl->vao);
-        extra->glBindVertexArray(m_egl->vao);
-        setupAttribs(); // capture the attribute layout into the VAO
-        extra->glBindVertexArray(0);
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-}
-
 #endif
@@ -7,6 +7,7 @@ extern "C" {
 }
 
 #include "qmlavdecoder.h"
+#include "qmlavreadahead.h"
 
 class QmlAVDemuxer;
 
@@ -57,9 +58,12 @@ public:
         delete audioDecoder;
 
         avformat_close_input(&avFormatCtx);
+        // NOTE: The custom AVIOContext is not closed by avformat_close_input(), it goes after the context
+        readAhead.reset();
     }
 
     AVFormatContext *avFormatCtx = nullptr;
+    std::unique_ptr<QmlAVReadAheadIO> readAhead; // AVFormatContext::pb, if enabled
     QmlAVInterruptCallback interruptCallback;
     QmlAVDecoder::Clock clock;
 
@@ -0,0 +1,93 @@
+#include "qmlavopenscheduler.h"
+
+#include <algorithm>
+
+QmlAVOpenScheduler &QmlAVOpenScheduler::instance()
+{
+    static QmlAVOpenScheduler scheduler;
+    return scheduler;
+}
+
+void QmlAVOpenScheduler::setLimit(int limit)
+{
+    std::scoped_lock lock(m_mutex);
+
+    m_limit = std::max(1, limit);
+    m_cond.notify_all();
+}
+
+int QmlAVOpenScheduler::limit() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_limit;
+}
+
+int QmlAVOpenScheduler::waitingCount() const
+{
+    std::scoped_lock lock(m_mutex);
+    return static_cast<int>(m_waiting.size());
+}
+
+QmlAVOpenScheduler::Slot QmlAVOpenScheduler::acquire(Ticket &ticket)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (ticket.cancelled) {
+        return Slot(*this, false);
+    }
+
+    ticket.order = m_nextOrder++;
+    m_waiting.push_back(&ticket);
+
+    m_cond.wait(lock, [&] {
+        // Executes in lock context
+        return ticket.cancelled || (m_running < m_limit && isNext(&ticket));
+    });
+
+    m_waiting.erase(std::find(m_waiting.begin(), m_waiting.end(), &ticket));
+
+    if (ticket.cancelled) {
+        // The next one may be granted now
+        m_cond.notify_all();
+        return Slot(*this, false);
+    }
+
+    ++m_running;
+    return Slot(*this, true);
+}
+
+void QmlAVOpenScheduler::setPriority(Ticket &ticket, int priority)
+{
+    std::scoped_lock lock(m_mutex);
+
+    if (ticket.priority != priority) {
+        ticket.priority = priority;
+        m_cond.notify_all();
+    }
+}
+
+void QmlAVOpenScheduler::cancel(Ticket &ticket)
+{
+    std::scoped_lock lock(m_mutex);
+
+    ticket.cancelled = true;
+    m_cond.notify_all();
+}
+
+void QmlAVOpenScheduler::release()
+{
+    std::scoped_lock lock(m_mutex);
+
+    --m_running;
+    m_cond.notify_all();
+}
+
+// NOTE: In lock context
+bool QmlAVOpenScheduler::isNext(const Ticket *ticket) const
+{
+    auto next = std::min_element(m_waiting.begin(), m_waiting.end(), [](const Ticket *a, const Ticket *b) {
+        return a->priority != b->priority ? a->priority > b->priority : a->order < b->order;
+    });
+
+    return next != m_waiting.end() && *next == ticket;
+}
@@ -0,0 +1,81 @@
+#ifndef QMLAVOPENSCHEDULER_H
+#define QMLAVOPENSCHEDULER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdint>
+
+// Process-wide bound of the sources being opened (and probed) at once, so loading a wall of players
+// doesn't hit the server and the network with all the connections simultaneously.
+// The waiting players are granted in the priority order, the equal ones in the arrival order.
+class QmlAVOpenScheduler
+{
+public:
+    static constexpr int DefaultLimit = 8;
+
+    // NOTE: Guarded by the scheduler, use its methods only!
+    class Ticket
+    {
+        int priority = 0;
+        uint64_t order = 0;
+        bool cancelled = false;
+
+        friend class QmlAVOpenScheduler;
+    };
+
+    // Holds the granted slot until destroyed
+    class Slot
+    {
+    public:
+        Slot(QmlAVOpenScheduler &scheduler, bool granted) : m_scheduler(scheduler), m_granted(granted) { }
+        ~Slot() {
+            if (m_granted) {
+                m_scheduler.release();
+            }
+        }
+
+        Slot(const Slot &other) = delete;
+        Slot &operator=(const Slot &other) = delete;
+
+        explicit operator bool() const { return m_granted; }
+
+    private:
+        QmlAVOpenScheduler &m_scheduler;
+        bool m_granted;
+    };
+
+    static QmlAVOpenScheduler &instance();
+
+    QmlAVOpenScheduler(const QmlAVOpenScheduler &other) = delete;
+    QmlAVOpenScheduler &operator=(const QmlAVOpenScheduler &other) = delete;
+
+    void setLimit(int limit);
+    int limit() const;
+    // The tickets waiting for a slot
+    int waitingCount() const;
+
+    // Blocks until a slot is granted, the slot is empty if the ticket has been cancelled meanwhile
+    Slot acquire(Ticket &ticket);
+    // Higher goes first, may be changed while waiting
+    void setPriority(Ticket &ticket, int priority);
+    // Wakes the waiting acquire(), the ticket is not granted anymore
+    void cancel(Ticket &ticket);
+
+protected:
+    QmlAVOpenScheduler() { }
+
+    void release();
+    bool isNext(const Ticket *ticket) const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    int m_limit = DefaultLimit;
+    int m_running = 0;
+    uint64_t m_nextOrder = 0;
+    std::vector<const Ticket *> m_waiting;
+};
+
+#endif // QMLAVOPENSCHEDULER_H
@@ -1,11 +1,16 @@
 #include "qmlavoptions.h"
+#include "qmlavhwoutput_gl.h"
 #include "qmlavhwoutput_vaapi_egl.h"
 #include "qmlavhwoutput_vaapi_glx.h"
 
 #include <QGuiApplication>
 
+#include <stdexcept>
+
 extern "C" {
+#include <libavutil/opt.h>
 #include <libavutil/parseutils.h>
+#include <libswscale/swscale.h>
 }
 
 QmlAVOptions::QmlAVOptions(const QVariantMap &avOptions)
@@ -39,6 +44,21 @@ LIBAVFORMAT_CONST AVInputFormat *QmlAVOptions::avInputFormat() const
     return avInputFormat;
 }
 
+// Of the recording (see QmlAVRecorder), guessed from the file name if not set
+LIBAVFORMAT_CONST AVOutputFormat *QmlAVOptions::avOutputFormat() const
+{
+    LIBAVFORMAT_CONST AVOutputFormat *avOutputFormat = nullptr;
+
+    find("f", [&](std::string value) {
+        avOutputFormat = av_guess_format(value.c_str(), nullptr, nullptr);
+        if (!avOutputFormat) {
+            logWarning() << "Unknown output format: -f " << value << ". Ignore this.";
+        }
+    });
+
+    return avOutputFormat;
+}
+
 AVHWDeviceType QmlAVOptions::avHWDeviceType() const
 {
     AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
@@ -78,6 +98,14 @@ std::shared_ptr<QmlAVHWOutput> QmlAVOptions::hwOutput() const
             hwOutput = std::make_shared<QmlAVHWOutput_VAAPI_EGL>();
             return;
         }
+        if (value == "gl") {
+            if (avHWDeviceType() != AV_HWDEVICE_TYPE_NONE) {
+                logWarning() << "The \"" << value << "\" output module is intended for software decoding only!";
+                return;
+            }
+            hwOutput = std::make_shared<QmlAVHWOutput_GL>();
+            return;
+        }
 #endif
 
         logWarning() << "Output module \"" << value << "\" is not supported!";
@@ -123,6 +151,99 @@ const AVCodec *QmlAVOptions::avCodec(const AVCodecParameters *avCodecPar) const
     return codec;
 }
 
+std::optional<int> QmlAVOptions::threadCount(const AVCodecParameters *avCodecPar) const
+{
+    std::optional<int> count = std::nullopt;
+
+    findStreamOpt("threads", avCodecPar, [&](std::string value) {
+        if (value == "share") {
+            count = ShareThreadCount;
+            return;
+        }
+        if (value == "auto") {
+            count = 0; // The same as in FFmpeg
+            return;
+        }
+
+        int n = std::stoi(value);
+        if (n < 0) {
+            throw std::out_of_range(value);
+        }
+
+        count = n; // 0 lets FFmpeg pick the thread count on its own
+    });
+
+    return count;
+}
+
+std::optional<int> QmlAVOptions::threadType(const AVCodecParameters *avCodecPar) const
+{
+    std::optional<int> type = std::nullopt;
+
+    findStreamOpt("thread_type", avCodecPar, [&](std::string value) {
+        if (value == "frame") {
+            type = FF_THREAD_FRAME;
+        } else if (value == "slice") {
+            type = FF_THREAD_SLICE;
+        } else if (value == "frame+slice" || value == "slice+frame") {
+            type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        } else {
+            throw std::invalid_argument(value);
+        }
+    });
+
+    return type;
+}
+
+// Slices of the color conversion/scaling of a video frame converted in parallel
+int QmlAVOptions::scalerThreadCount() const
+{
+    int count = AutoThreadCount;
+
+    find("scaler_threads", [&](std::string value) {
+        if (value == "auto") {
+            count = AutoThreadCount;
+            return;
+        }
+
+        int n = std::stoi(value);
+        if (n < 1) {
+            throw std::out_of_range(value);
+        }
+
+        count = n;
+    });
+
+    return count;
+}
+
+// The same syntax as the -sws_flags option of ffmpeg, e.g. "bicubic+accurate_rnd"
+std::optional<int> QmlAVOptions::scalerFlags() const
+{
+    std::optional<int> flags = std::nullopt;
+
+    find("scaler_flags", [&](std::string value) {
+        // Let swscale parse its own flag names
+        SwsContext *swsCtx = sws_alloc_context();
+        int64_t n = 0;
+
+        int ret = av_opt_set(swsCtx, "sws_flags", value.c_str(), 0);
+        if (ret >= 0) {
+            ret = av_opt_get_int(swsCtx, "sws_flags", 0, &n);
+        }
+
+        sws_freeContext(swsCtx);
+
+        if (ret < 0) {
+            throw std::invalid_argument(value);
+        }
+
+        flags = static_cast<int>(n);
+    });
+
+    return flags;
+}
+
 uint32_t QmlAVOptions::demuxerTimeout() const
 {
     uint32_t t = 30000000; // 30 sec. by default
@@ -134,6 +255,39 @@ uint32_t QmlAVOptions::demuxerTimeout() const
     return t;
 }
 
+uint32_t QmlAVOptions::packetQueueSize() const
+{
+    uint32_t size = 8 * 1024 * 1024; // 8 MB per decoder by default
+
+    find("packet_queue_size", [&](uint32_t value) {
+        size = value;
+    });
+
+    return size;
+}
+
+uint32_t QmlAVOptions::packetQueueDuration() const
+{
+    uint32_t duration = 2000000; // 2 sec. by default
+
+    find("packet_queue_duration", [&](uint32_t value) {
+        duration = value;
+    });
+
+    return duration;
+}
+
+uint32_t QmlAVOptions::packetDropLatency() const
+{
+    uint32_t latency = 1000000; // 1 sec. by default
+
+    find("packet_drop_latency", [&](uint32_t value) {
+        latency = value;
+    });
+
+    return latency;
+}
+
 bool QmlAVOptions::videoDisable() const
 {
     bool disable = false;
@@ -167,6 +321,94 @@ std::optional<bool> QmlAVOptions::realTime() const
     return rt;
 }
 
+// Skip avformat_find_stream_info() for the sources probed before (see QmlAVProbeCache)
+std::optional<bool> QmlAVOptions::probeCache() const
+{
+    std::optional<bool> cache = std::nullopt;
+
+    find("probe_cache", [&](bool value) {
+        cache = value;
+    });
+
+    return cache;
+}
+
+// Keeps the probe cache across the application restarts
+std::string QmlAVOptions::probeCacheFile() const
+{
+    std::string fileName;
+
+    find("probe_cache_file", [&](std::string value) {
+        fileName = value;
+    });
+
+    return fileName;
+}
+
+// Reopen a lost source in place, keeping the decoders (see QmlAVDemuxer::reconnect()).
+// Off by default: the source is retried for as long as it is lost, regardless of the player loops.
+bool QmlAVOptions::warmReconnect() const
+{
+    bool reconnect = false;
+
+    find("warm_reconnect", [&](bool value) {
+        reconnect = value;
+    });
+
+    return reconnect;
+}
+
+// Process-wide, see QmlAVOpenScheduler
+std::optional<int> QmlAVOptions::openConcurrency() const
+{
+    std::optional<int> limit = std::nullopt;
+
+    find("open_concurrency", [&](std::string value) {
+        int n = std::stoi(value);
+        if (n < 1) {
+            throw std::out_of_range(value);
+        }
+
+        limit = n;
+    });
+
+    return limit;
+}
+
+// See QmlAVReadAheadIO, disabled by default
+uint32_t QmlAVOptions::readAheadSize() const
+{
+    uint32_t size = 0;
+
+    find("read_ahead_size", [&](uint32_t value) {
+        size = value;
+    });
+
+    return size;
+}
+
+uint32_t QmlAVOptions::readAheadDelay() const
+{
+    uint32_t t = 100000; // 100 ms by default
+
+    find("read_ahead_delay", [&](uint32_t value) {
+        t = value;
+    });
+
+    return t;
+}
+
+uint32_t QmlAVOptions::recordQueueSize() const
+{
+    uint32_t size = 16 * 1024 * 1024; // 16 MB by default
+
+    find("record_queue_size", [&](uint32_t value) {
+        size = value;
+    });
+
+    return size;
+}
+
 std::optional<AVRational> QmlAVOptions::aspectRatio() const
 {
     std::optional<AVRational> ratio = std::nullopt;
@@ -196,6 +438,30 @@ uint32_t QmlAVOptions::sTo<uint32_t>(std::string value) const
     return std::stoul(value);
 }
 
+// Stream specific "opt:v" ("opt:a") takes precedence over the global "opt"
+template<typename Callback>
+int QmlAVOptions::findStreamOpt(std::string opt, const AVCodecParameters *avCodecPar, Callback cb) const
+{
+    if (avCodecPar) {
+        switch (avCodecPar->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            if (int count = find(opt + ":v", cb)) {
+                return count;
+            }
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            if (int count = find(opt + ":a", cb)) {
+                return count;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    return find(opt, cb);
+}
+
 template<typename Callback>
 int QmlAVOptions::find(std::string opt, Callback cb) const
 {
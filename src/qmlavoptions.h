@@ -22,6 +22,9 @@ public:
     void set(std::string key, std::string value) {
         av_dict_set(m_avDict.get(), key.c_str(), value.c_str(), AV_DICT_MULTIKEY);
     }
+    void remove(std::string key) {
+        av_dict_set(m_avDict.get(), key.c_str(), nullptr, 0);
+    }
 
     operator AVDictionary *() { return *m_avDict.get(); }
     operator AVDictionary **() { return m_avDict.get(); }
@@ -49,6 +52,13 @@ public:
         MultiKey
     };
 
+    // The "auto" scaler thread count: the cores are divided across the scalers in use in the process,
+    // up to a few threads per scaling context. The count of a context is fixed at its creation.
+    static constexpr int AutoThreadCount = -1;
+    // The "share" decoder thread count: the cores are divided across the software video decoders in the process
+    // as they are opened, the share of a decoder is fixed at its open time. Other decoders get a single thread.
+    static constexpr int ShareThreadCount = -2;
+
     QmlAVOptions() { }
     QmlAVOptions(const QVariantMap &avOptions);
     operator const QVariantMap&() const { return m_avOptions; }
@@ -56,17 +66,33 @@ public:
     operator AVDictionaryPtr() const;
 
     LIBAVFORMAT_CONST AVInputFormat *avInputFormat() const;
+    LIBAVFORMAT_CONST AVOutputFormat *avOutputFormat() const;
     AVHWDeviceType avHWDeviceType() const;
     std::shared_ptr<QmlAVHWOutput> hwOutput() const;
     const AVCodec *avCodec(const AVCodecParameters *avCodecPar) const;
+    std::optional<int> threadCount(const AVCodecParameters *avCodecPar) const;
+    std::optional<int> threadType(const AVCodecParameters *avCodecPar) const;
+    int scalerThreadCount() const;
+    std::optional<int> scalerFlags() const;
     uint32_t demuxerTimeout() const;
+    uint32_t packetQueueSize() const;
+    uint32_t packetQueueDuration() const;
+    uint32_t packetDropLatency() const;
     bool videoDisable() const;
     bool audioDisable() const;
     std::optional<bool> realTime() const;
+    std::optional<bool> probeCache() const;
+    std::string probeCacheFile() const;
+    bool warmReconnect() const;
+    std::optional<int> openConcurrency() const;
+    uint32_t readAheadSize() const;
+    uint32_t readAheadDelay() const;
+    uint32_t recordQueueSize() const;
     std::optional<AVRational> aspectRatio() const;
 
 protected:
     template<typename T> T sTo(std::string value) const { return value; }
+    template<typename Callback> int findStreamOpt(std::string opt, const AVCodecParameters *avCodecPar, Callback cb) const;
     template<typename Callback> int find(std::string opt, Callback cb) const;
     template<typename Callback> int find(std::vector<std::string> opts, Callback cb) const;
 
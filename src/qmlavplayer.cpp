@@ -1,10 +1,16 @@
 #include "qmlavplayer.h"
 
+#include <algorithm>
+
+#define RESTART_DELAY_MIN 250 // ms
+#define RESTART_DELAY_MAX 16000 // ms
+
 QmlAVPlayer::QmlAVPlayer(QObject *parent)
     : QObject(parent)
     , m_complete(false)
     , m_demuxer(nullptr)
     , m_videoSurface(nullptr)
+    , m_restartDelay(RESTART_DELAY_MIN)
     , m_audioOutput(nullptr)
 {
     qRegisterMetaType<QList<QVideoFrame::PixelFormat>>();
@@ -63,6 +69,27 @@ void QmlAVPlayer::stop()
     setPlaybackState(QMediaPlayer::StoppedState);
     setHasVideo(false);
     setHasAudio(false);
+    setRecording(false);
+}
+
+bool QmlAVPlayer::startRecording(const QUrl &url, const QVariantMap &options)
+{
+    logDebug() << "startRecording()";
+
+    if (!m_demuxer) {
+        return false;
+    }
+
+    return m_demuxer->startRecording(url.isLocalFile() ? url.toLocalFile() : url.toString(), options);
+}
+
+void QmlAVPlayer::stopRecording()
+{
+    logDebug() << "stopRecording()";
+
+    if (m_demuxer) {
+        m_demuxer->stopRecording();
+    }
 }
 
 void QmlAVPlayer::setVideoSurface(QAbstractVideoSurface *surface)
@@ -77,11 +104,18 @@ void QmlAVPlayer::setVideoSurface(QAbstractVideoSurface *surface)
 void QmlAVPlayer::frameHandler(const std::shared_ptr<QmlAVFrame> frame)
 {
     if (m_playbackState == QMediaPlayer::PlayingState) {
+        m_restartDelay = RESTART_DELAY_MIN;
+
         if (frame->type() == QmlAVFrame::TypeVideo) {
             auto vf = std::static_pointer_cast<QmlAVVideoFrame>(frame);
             QVideoFrame qvf = *vf;
 
             if (m_videoSurface) {
+                // The frame size follows the render size (see QmlAVVideoDecoder::downscale())
+                if (m_videoSurface->isActive() && m_videoSurface->surfaceFormat().frameSize() != qvf.size()) {
+                    m_videoSurface->stop();
+                }
+
                 if (!m_videoSurface->isActive()) {
                     QVideoSurfaceFormat f(qvf.size(), qvf.pixelFormat(), qvf.handleType());
 
@@ -222,14 +256,49 @@ void QmlAVPlayer::setVolume(QmlAVPropertyType<double> volume)
     emit volumeChanged(volume);
 }
 
+void QmlAVPlayer::setDecodeMode(QmlAVPropertyType<DecodeMode> decodeMode)
+{
+    if (m_decodeMode == decodeMode) {
+        return;
+    }
+
+    m_decodeMode = decodeMode;
+
+    // Applied on the fly, no reload required
+    if (m_demuxer) {
+        m_demuxer->setDecodeMode(static_cast<QmlAVDecoder::DecodeMode>(decodeMode));
+    }
+
+    emit decodeModeChanged(decodeMode);
+}
+
+void QmlAVPlayer::setRenderSize(QmlAVPropertyType<QSize> renderSize)
+{
+    if (m_renderSize == renderSize) {
+        return;
+    }
+
+    m_renderSize = renderSize;
+
+    // Frames are downscaled on the fly, low-res decoding is chosen on the next load
+    if (m_demuxer) {
+        m_demuxer->setRenderSize(renderSize);
+    }
+
+    emit renderSizeChanged(renderSize);
+}
+
 bool QmlAVPlayer::load()
 {
     if (!m_demuxer && m_source.isValid()) {
         m_demuxer = new QmlAVDemuxer();
+        m_demuxer->setDecodeMode(static_cast<QmlAVDecoder::DecodeMode>(m_decodeMode));
+        m_demuxer->setRenderSize(m_renderSize);
 
         connect(m_demuxer, &QmlAVDemuxer::frameFinished, this, &QmlAVPlayer::frameHandler);
         connect(m_demuxer, &QmlAVDemuxer::playbackStateChanged, this, &QmlAVPlayer::setPlaybackState);
         connect(m_demuxer, &QmlAVDemuxer::mediaStatusChanged, this, &QmlAVPlayer::setStatus);
+        connect(m_demuxer, &QmlAVDemuxer::recordingChanged, this, &QmlAVPlayer::setRecording);
 
         m_demuxer->load(m_source, m_avOptions);
 
@@ -256,7 +325,9 @@ void QmlAVPlayer::stateMachine()
                 stop();
 
                 if (m_loops == -1 /*MediaPlayer.Infinite*/) {
-                    m_playTimer.start(1000);
+                    // Exponential backoff, reset by the first decoded frame (see frameHandler())
+                    m_playTimer.start(m_restartDelay);
+                    m_restartDelay = std::min(m_restartDelay * 2, RESTART_DELAY_MAX);
                 }
             }
 
@@ -338,3 +409,16 @@ void QmlAVPlayer::setHasAudio(bool hasAudio)
 
     emit hasAudioChanged(hasAudio);
 }
+
+void QmlAVPlayer::setRecording(bool recording)
+{
+    if (m_recording == recording) {
+        return;
+    }
+
+    logDebug() << QString("setRecording(recording=%1)").arg(recording);
+
+    m_recording = recording;
+
+    emit recordingChanged(recording);
+}
@@ -18,6 +18,16 @@ class QmlAVPlayer : public QObject, public QQmlParserStatus
     Q_OBJECT
     Q_INTERFACES(QQmlParserStatus)
 
+public:
+    // Video decoding effort, e.g. for hidden or tiny outputs
+    enum DecodeMode {
+        Full = QmlAVDecoder::DecodeFull,
+        ReferenceOnly = QmlAVDecoder::DecodeReferenceOnly,
+        KeyframesOnly = QmlAVDecoder::DecodeKeyframesOnly,
+        Paused = QmlAVDecoder::DecodePaused
+    };
+    Q_ENUM(DecodeMode)
+
     Q_PROPERTY(QAbstractVideoSurface *videoSurface READ videoSurface WRITE setVideoSurface)
 
     QMLAV_PROPERTY_DECL(QVariantMap, avOptions, setAVOptions, avOptionsChanged);
@@ -30,8 +40,11 @@ class QmlAVPlayer : public QObject, public QQmlParserStatus
     QMLAV_PROPERTY_READONLY(QVariant, bufferProgress, bufferProgressChanged) = 1.0; // TODO:
     QMLAV_PROPERTY(bool, muted, setMuted, mutedChanged) = false; // TODO:
     QMLAV_PROPERTY_DECL(double, volume, setVolume, volumeChanged) = 0.0;
+    QMLAV_PROPERTY_DECL(DecodeMode, decodeMode, setDecodeMode, decodeModeChanged) = Full;
+    QMLAV_PROPERTY_DECL(QSize, renderSize, setRenderSize, renderSizeChanged); // Empty for the original frame size
     QMLAV_PROPERTY_READONLY(bool, hasVideo, hasVideoChanged) = false;
     QMLAV_PROPERTY_READONLY(bool, hasAudio, hasAudioChanged) = false;
+    QMLAV_PROPERTY_READONLY(bool, recording, recordingChanged) = false;
 
 public:
     QmlAVPlayer(QObject *parent = nullptr);
@@ -41,6 +54,11 @@ public:
     virtual void classBegin() override {}
     virtual void componentComplete() override;
 
+    // The demuxed packets are written as is, no re-encoding. The options select the format ("f", guessed
+    // from the file name by default) and the muxer options, e.g. { "f": "segment", "segment_time": 60 }.
+    Q_INVOKABLE bool startRecording(const QUrl &url, const QVariantMap &options = QVariantMap());
+    Q_INVOKABLE void stopRecording();
+
 signals:
     void videoFramePresented();
 
@@ -59,12 +77,15 @@ protected:
     void setStatus(const QMediaPlayer::MediaStatus status);
     void setHasVideo(bool hasVideo);
     void setHasAudio(bool hasAudio);
+    void setRecording(bool recording);
 
 private:
     bool m_complete;
     QmlAVDemuxer *m_demuxer;
     QAbstractVideoSurface *m_videoSurface;
+
     QTimer m_playTimer;
+    int m_restartDelay; // ms
 
     QmlAVAudioIODevice m_audioIODevice;
     QAudioOutput *m_audioOutput;
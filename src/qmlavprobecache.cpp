@@ -0,0 +1,426 @@
+#include "qmlavprobecache.h"
+#include "qmlavutils.h"
+
+#include <cstring>
+
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/samplefmt.h>
+}
+
+#define PROBE_CACHE_LIMIT 64 // Sources
+#define PROBE_CACHE_FILE_VERSION 2
+#define PROBE_CACHE_SAVE_DELAY 1000000 // 1 sec., the stores meanwhile are written at once
+
+namespace {
+
+QJsonArray rationalToJson(AVRational q)
+{
+    return { q.num, q.den };
+}
+
+AVRational rationalFromJson(const QJsonValue &value)
+{
+    QJsonArray a = value.toArray();
+    return { a.at(0).toInt(0), a.at(1).toInt(1) };
+}
+
+int channelCount(const AVCodecParameters *codecPar)
+{
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(59, 24, 100)
+    return codecPar->channels;
+#else
+    return codecPar->ch_layout.nb_channels;
+#endif
+}
+
+} // namespace
+
+QmlAVProbeCache &QmlAVProbeCache::instance(const QString &fileName)
+{
+    // NOTE: The statics are destroyed in the reverse order, the pool has to outlive the saver threads
+    QmlAVThreadPool::instance();
+
+    static std::mutex mutex;
+    static std::map<QString, std::unique_ptr<QmlAVProbeCache>> caches;
+
+    std::scoped_lock lock(mutex);
+
+    auto &cache = caches[fileName];
+    if (!cache) {
+        cache.reset(new QmlAVProbeCache(fileName));
+    }
+
+    return *cache;
+}
+
+QmlAVProbeCache::QmlAVProbeCache(const QString &fileName)
+    : m_fileName(fileName)
+    , m_modified(false)
+    , m_saveDelayed(false)
+{
+    if (m_fileName.isEmpty()) {
+        return;
+    }
+
+    load();
+
+    m_saverThread = QmlAVThread::loopPooled([this]() {
+        return saver();
+    });
+}
+
+QmlAVProbeCache::~QmlAVProbeCache()
+{
+    m_saverThread.requestInterrupt(true);
+
+    // The pending changes aren't lost
+    if (m_modified) {
+        save();
+    }
+}
+
+bool QmlAVProbeCache::restore(const QString &source, AVFormatContext *avFormatCtx)
+{
+    std::scoped_lock lock(m_mutex);
+
+    auto it = m_index.find(source);
+    if (it == m_index.end()) {
+        return false;
+    }
+
+    const Entry &entry = it->second->second;
+
+    if (!matches(entry, avFormatCtx)) {
+        logDebug() << "Cached stream info mismatch for " << QmlAV::Quote << source;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+        return false;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    for (unsigned int i = 0; i < avFormatCtx->nb_streams; ++i) {
+        AVStream *avStream = avFormatCtx->streams[i];
+        const Stream &stream = entry[i];
+
+        if (avcodec_parameters_copy(avStream->codecpar, stream.codecPar.get()) < 0) {
+            return false;
+        }
+        if (!avStream->avg_frame_rate.num) {
+            avStream->avg_frame_rate = stream.avgFrameRate;
+        }
+        if (!avStream->r_frame_rate.num) {
+            avStream->r_frame_rate = stream.rFrameRate;
+        }
+    }
+
+    return true;
+}
+
+void QmlAVProbeCache::store(const QString &source, const AVFormatContext *avFormatCtx)
+{
+    Entry entry;
+
+    for (unsigned int i = 0; i < avFormatCtx->nb_streams; ++i) {
+        const AVStream *avStream = avFormatCtx->streams[i];
+
+        // Not worth caching, the next probe may be more lucky
+        if (!isComplete(avStream->codecpar)) {
+            return;
+        }
+
+        Stream stream;
+        if (avcodec_parameters_copy(stream.codecPar.get(), avStream->codecpar) < 0) {
+            return;
+        }
+        stream.avgFrameRate = avStream->avg_frame_rate;
+        stream.rFrameRate = avStream->r_frame_rate;
+
+        entry.push_back(std::move(stream));
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        insert(source, std::move(entry));
+        m_modified = !m_fileName.isEmpty();
+    }
+
+    m_saverThread.wake();
+}
+
+// Makes the entry the most recently used one, evicting the least recently used ones over the limit
+// NOTE: In lock context
+void QmlAVProbeCache::insert(const QString &source, Entry entry)
+{
+    auto it = m_index.find(source);
+    if (it != m_index.end()) {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    while (m_entries.size() >= PROBE_CACHE_LIMIT) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+
+    m_entries.emplace_front(source, std::move(entry));
+    m_index.emplace(source, m_entries.begin());
+}
+
+bool QmlAVProbeCache::matches(const Entry &entry, const AVFormatContext *avFormatCtx)
+{
+    if (entry.size() != avFormatCtx->nb_streams) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < avFormatCtx->nb_streams; ++i) {
+        const AVCodecParameters *opened = avFormatCtx->streams[i]->codecpar;
+        const AVCodecParameters *cached = entry[i].codecPar.get();
+
+        if (opened->codec_type != cached->codec_type || opened->codec_id != cached->codec_id) {
+            return false;
+        }
+
+        // Whatever the opened stream already knows (e.g. the SDP "sprop-parameter-sets") is up to date,
+        // a difference means the source has been reconfigured since.
+        if (opened->extradata_size > 0
+            && (opened->extradata_size != cached->extradata_size
+                || memcmp(opened->extradata, cached->extradata, opened->extradata_size) != 0)) {
+            return false;
+        }
+        if ((opened->width > 0 && opened->width != cached->width)
+            || (opened->height > 0 && opened->height != cached->height)
+            || (opened->sample_rate > 0 && opened->sample_rate != cached->sample_rate)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Enough for the decoder to be opened without probing
+bool QmlAVProbeCache::isComplete(const AVCodecParameters *codecPar)
+{
+    switch (codecPar->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        return codecPar->codec_id != AV_CODEC_ID_NONE && codecPar->format >= 0
+                && codecPar->width > 0 && codecPar->height > 0;
+    case AVMEDIA_TYPE_AUDIO:
+        return codecPar->codec_id != AV_CODEC_ID_NONE && codecPar->format >= 0
+                && codecPar->sample_rate > 0 && channelCount(codecPar) > 0;
+    default:
+        return true;
+    }
+}
+
+// NOTE: From the constructor only
+void QmlAVProbeCache::load()
+{
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return; // Not created yet
+    }
+
+    QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+    if (json["version"].toInt() != PROBE_CACHE_FILE_VERSION) {
+        logWarning() << "Ignoring the stream info cache " << QmlAV::Quote << m_fileName << ": unknown format";
+        return;
+    }
+
+    // From the most recently used one, so the oldest ones are evicted (if the limit is lower now)
+    const QJsonArray sources = json["sources"].toArray();
+    for (int i = sources.size() - 1; i >= 0; --i) {
+        const QJsonObject source = sources.at(i).toObject();
+
+        Entry entry;
+        for (const QJsonValue &stream : source["streams"].toArray()) {
+            entry.push_back(Stream::fromJson(stream.toObject()));
+        }
+
+        insert(source["source"].toString(), std::move(entry));
+    }
+}
+
+// The entries are copied in lock context, the file is written out of it.
+// NOTE: From the saver thread (or the destructor) only, so the writes don't overlap
+void QmlAVProbeCache::save()
+{
+    Entries entries;
+    {
+        std::scoped_lock lock(m_mutex);
+
+        entries = m_entries; // The parameters are shared, never modified once stored
+        m_modified = false;
+    }
+
+    QJsonArray sources;
+    for (const auto &[source, entry] : entries) {
+        QJsonArray streams;
+        for (const Stream &stream : entry) {
+            streams.append(stream.toJson());
+        }
+        sources.append(QJsonObject{
+            { "source", source },
+            { "streams", streams }
+        });
+    }
+
+    QJsonObject json;
+    json["version"] = PROBE_CACHE_FILE_VERSION;
+    json["sources"] = sources;
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(json).toJson()) < 0 || !file.commit()) {
+        logWarning() << "Unable to save the stream info cache " << QmlAV::Quote << m_fileName << ": " << file.errorString();
+    }
+}
+
+// Waits for the changes, then lets them accumulate for a while before they are saved
+// NOTE: Executes in the saver thread context
+QmlAVLoopController QmlAVProbeCache::saver()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (!m_modified) {
+            m_saveDelayed = false;
+            return QmlAVLoopController::waitUntil(QmlAVLoopController::Continue);
+        }
+    }
+
+    if (!m_saveDelayed) {
+        m_saveDelayed = true;
+        return QmlAVLoopController(PROBE_CACHE_SAVE_DELAY);
+    }
+
+    m_saveDelayed = false;
+    save();
+
+    return QmlAVLoopController::Continue;
+}
+
+QmlAVProbeCache::Stream::Stream()
+    : codecPar(avcodec_parameters_alloc(), [](AVCodecParameters *p) { avcodec_parameters_free(&p); })
+    , avgFrameRate({0, 1})
+    , rFrameRate({0, 1})
+{
+}
+
+// NOTE: The codecs and the formats are stored by name, their enum values are not stable across FFmpeg versions
+QJsonObject QmlAVProbeCache::Stream::toJson() const
+{
+    const AVCodecParameters *p = codecPar.get();
+
+    const char *format = nullptr;
+    if (p->codec_type == AVMEDIA_TYPE_VIDEO) {
+        format = av_get_pix_fmt_name(static_cast<AVPixelFormat>(p->format));
+    } else if (p->codec_type == AVMEDIA_TYPE_AUDIO) {
+        format = av_get_sample_fmt_name(static_cast<AVSampleFormat>(p->format));
+    }
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(59, 24, 100)
+    uint64_t channelMask = p->channel_layout;
+#else
+    uint64_t channelMask = p->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? p->ch_layout.u.mask : 0;
+#endif
+
+    return {
+        { "codec_type", static_cast<int>(p->codec_type) },
+        { "codec", avcodec_get_name(p->codec_id) },
+        { "codec_tag", static_cast<qint64>(p->codec_tag) },
+        { "format", format ? format : "" },
+        { "bit_rate", static_cast<qint64>(p->bit_rate) },
+        { "bits_per_coded_sample", p->bits_per_coded_sample },
+        { "bits_per_raw_sample", p->bits_per_raw_sample },
+        { "profile", p->profile },
+        { "level", p->level },
+        { "width", p->width },
+        { "height", p->height },
+        { "sample_aspect_ratio", rationalToJson(p->sample_aspect_ratio) },
+        { "field_order", static_cast<int>(p->field_order) },
+        { "color_range", static_cast<int>(p->color_range) },
+        { "color_primaries", static_cast<int>(p->color_primaries) },
+        { "color_trc", static_cast<int>(p->color_trc) },
+        { "color_space", static_cast<int>(p->color_space) },
+        { "chroma_location", static_cast<int>(p->chroma_location) },
+        { "video_delay", p->video_delay },
+        { "channels", channelCount(p) },
+        { "channel_mask", static_cast<qint64>(channelMask) },
+        { "sample_rate", p->sample_rate },
+        { "block_align", p->block_align },
+        { "frame_size", p->frame_size },
+        { "extradata", QString::fromLatin1(QByteArray(reinterpret_cast<const char *>(p->extradata), p->extradata_size).toBase64()) },
+        { "avg_frame_rate", rationalToJson(avgFrameRate) },
+        { "r_frame_rate", rationalToJson(rFrameRate) }
+    };
+}
+
+QmlAVProbeCache::Stream QmlAVProbeCache::Stream::fromJson(const QJsonObject &json)
+{
+    Stream stream;
+    AVCodecParameters *p = stream.codecPar.get(); // The defaults are the "unknown" values
+
+    p->codec_type = static_cast<AVMediaType>(json["codec_type"].toInt(p->codec_type));
+    const AVCodecDescriptor *desc = avcodec_descriptor_get_by_name(json["codec"].toString().toUtf8().constData());
+    p->codec_id = desc ? desc->id : AV_CODEC_ID_NONE; // Never matches an opened stream then
+    p->codec_tag = static_cast<uint32_t>(json["codec_tag"].toVariant().toLongLong());
+
+    QByteArray format = json["format"].toString().toUtf8();
+    if (p->codec_type == AVMEDIA_TYPE_VIDEO) {
+        p->format = av_get_pix_fmt(format.constData());
+    } else if (p->codec_type == AVMEDIA_TYPE_AUDIO) {
+        p->format = av_get_sample_fmt(format.constData());
+    }
+
+    p->bit_rate = json["bit_rate"].toVariant().toLongLong();
+    p->bits_per_coded_sample = json["bits_per_coded_sample"].toInt();
+    p->bits_per_raw_sample = json["bits_per_raw_sample"].toInt();
+    p->profile = json["profile"].toInt(p->profile);
+    p->level = json["level"].toInt(p->level);
+    p->width = json["width"].toInt();
+    p->height = json["height"].toInt();
+    p->sample_aspect_ratio = rationalFromJson(json["sample_aspect_ratio"]);
+    p->field_order = static_cast<AVFieldOrder>(json["field_order"].toInt(p->field_order));
+    p->color_range = static_cast<AVColorRange>(json["color_range"].toInt(p->color_range));
+    p->color_primaries = static_cast<AVColorPrimaries>(json["color_primaries"].toInt(p->color_primaries));
+    p->color_trc = static_cast<AVColorTransferCharacteristic>(json["color_trc"].toInt(p->color_trc));
+    p->color_space = static_cast<AVColorSpace>(json["color_space"].toInt(p->color_space));
+    p->chroma_location = static_cast<AVChromaLocation>(json["chroma_location"].toInt(p->chroma_location));
+    p->video_delay = json["video_delay"].toInt();
+    p->sample_rate = json["sample_rate"].toInt();
+    p->block_align = json["block_align"].toInt();
+    p->frame_size = json["frame_size"].toInt();
+
+    int channels = json["channels"].toInt();
+    uint64_t channelMask = static_cast<uint64_t>(json["channel_mask"].toVariant().toLongLong());
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(59, 24, 100)
+    p->channels = channels;
+    p->channel_layout = channelMask ? channelMask : av_get_default_channel_layout(channels);
+#else
+    if (!channelMask || av_channel_layout_from_mask(&p->ch_layout, channelMask) < 0) {
+        av_channel_layout_default(&p->ch_layout, channels);
+    }
+#endif
+
+    QByteArray extradata = QByteArray::fromBase64(json["extradata"].toString().toLatin1());
+    if (!extradata.isEmpty()) {
+        p->extradata = static_cast<uint8_t *>(av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+        if (p->extradata) {
+            memcpy(p->extradata, extradata.constData(), extradata.size());
+            p->extradata_size = extradata.size();
+        }
+    }
+
+    stream.avgFrameRate = rationalFromJson(json["avg_frame_rate"]);
+    stream.rFrameRate = rationalFromJson(json["r_frame_rate"]);
+
+    return stream;
+}
@@ -0,0 +1,77 @@
+#ifndef QMLAVPROBECACHE_H
+#define QMLAVPROBECACHE_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <mutex>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <QString>
+#include <QJsonObject>
+
+#include "qmlavthread.h"
+
+// Stream layouts and codec parameters found by avformat_find_stream_info() per source, so the next load
+// of the same source (e.g. reconnecting to a camera) doesn't have to read and decode seconds of the stream again.
+// Optionally persisted to a JSON file to survive restarts, the changes are written out in the background.
+// NOTE: Process-wide per file and thread safe.
+class QmlAVProbeCache
+{
+public:
+    // The cache of the file, loaded on first use. The one of an empty name is kept in memory only.
+    static QmlAVProbeCache &instance(const QString &fileName = QString());
+
+    virtual ~QmlAVProbeCache();
+
+    QmlAVProbeCache(const QmlAVProbeCache &other) = delete;
+    QmlAVProbeCache &operator=(const QmlAVProbeCache &other) = delete;
+
+    // Completes the streams of the opened context from the cache. Returns false on a miss or when the opened
+    // streams don't match the cached ones anymore, the full probe is required then.
+    bool restore(const QString &source, AVFormatContext *avFormatCtx);
+    // Remembers the streams of the fully probed context
+    void store(const QString &source, const AVFormatContext *avFormatCtx);
+
+protected:
+    QmlAVProbeCache(const QString &fileName);
+
+    struct Stream {
+        std::shared_ptr<AVCodecParameters> codecPar;
+        AVRational avgFrameRate;
+        AVRational rFrameRate;
+
+        Stream();
+        QJsonObject toJson() const;
+        static Stream fromJson(const QJsonObject &json);
+    };
+    using Entry = std::vector<Stream>;
+    using Entries = std::list<std::pair<QString, Entry>>;
+
+    static bool matches(const Entry &entry, const AVFormatContext *avFormatCtx);
+    static bool isComplete(const AVCodecParameters *codecPar);
+
+    void insert(const QString &source, Entry entry);
+    void load();
+    void save();
+    QmlAVLoopController saver();
+
+private:
+    const QString m_fileName;
+
+    std::mutex m_mutex;
+    // From the most recently used one
+    Entries m_entries;
+    std::map<QString, Entries::iterator> m_index;
+    bool m_modified;
+
+    // Saver thread context only
+    bool m_saveDelayed;
+    QmlAVThreadLiveController<QmlAVLoopController> m_saverThread;
+};
+
+#endif // QMLAVPROBECACHE_H
@@ -0,0 +1,187 @@
+#include "qmlavreadahead.h"
+#include "qmlavmediacontextholder.h"
+#include "qmlavoptions.h"
+#include "qmlavutils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define AVIO_BUFFER_SIZE 32768 // The demuxer side reads
+#define READ_CHUNK_SIZE 65536  // A single network read
+
+QmlAVReadAheadIO::QmlAVReadAheadIO(size_t size, int64_t delay, int64_t timeout, const QmlAVInterruptCallback &interruptCallback)
+    : m_capacity(std::max<size_t>(size, READ_CHUNK_SIZE))
+    , m_delay(std::max<int64_t>(delay, 0))
+    , m_timeout(std::max<int64_t>(timeout, 0))
+    , m_parentInterruptCallback(interruptCallback)
+    , m_stopRequested(false)
+    , m_expireTime(0)
+    , m_protocolCtx(nullptr)
+    , m_avioCtx(nullptr)
+    , m_ring(m_capacity)
+    , m_head(0)
+    , m_size(0)
+    , m_emptySince()
+    , m_error(0)
+    , m_chunk(READ_CHUNK_SIZE)
+{
+    m_interruptCallback.opaque = this;
+    m_interruptCallback.callback = [](void *opaque) -> int {
+        assert(opaque);
+        auto self = static_cast<QmlAVReadAheadIO *>(opaque);
+        return self->m_stopRequested.load(std::memory_order_relaxed)
+                || self->m_parentInterruptCallback.isAVInterruptRequested()
+                || (self->m_expireTime > 0 && av_gettime_relative() > self->m_expireTime);
+    };
+}
+
+QmlAVReadAheadIO::~QmlAVReadAheadIO()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stopRequested = true;
+        m_cond.notify_all();
+    }
+
+    // The network read in progress is aborted by the interrupt callback
+    m_readerThread.requestInterrupt(true);
+
+    if (m_avioCtx) {
+        av_freep(&m_avioCtx->buffer);
+        avio_context_free(&m_avioCtx);
+    }
+    avio_closep(&m_protocolCtx);
+}
+
+bool QmlAVReadAheadIO::open(const QString &url, const QmlAVOptions &avOptions)
+{
+    AVDictionaryPtr dict = static_cast<AVDictionaryPtr>(avOptions);
+    resetTimer();
+    int ret = avio_open2(&m_protocolCtx, url.toUtf8(), AVIO_FLAG_READ, &m_interruptCallback, dict);
+    if (ret < 0) {
+        logWarning() << QString("Unable to open input: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+        return false;
+    }
+
+    auto buffer = static_cast<unsigned char *>(av_malloc(AVIO_BUFFER_SIZE));
+    if (buffer) {
+        m_avioCtx = avio_alloc_context(buffer, AVIO_BUFFER_SIZE, 0, this, &QmlAVReadAheadIO::readPacket, nullptr, nullptr);
+    }
+    if (!m_avioCtx) {
+        av_free(buffer);
+        logWarning() << "Unable allocate AVIO context";
+        return false;
+    }
+    m_avioCtx->seekable = 0; // Everything read is consumed
+
+    m_readerThread = QmlAVThread::loop([this]() {
+        return fill();
+    });
+
+    return true;
+}
+
+int QmlAVReadAheadIO::readPacket(void *opaque, uint8_t *buf, int size)
+{
+    assert(opaque);
+    return static_cast<QmlAVReadAheadIO *>(opaque)->read(buf, size);
+}
+
+// NOTE: Executes in the demuxer thread context
+int QmlAVReadAheadIO::read(uint8_t *buf, int size)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;) {
+        if (m_stopRequested) {
+            return AVERROR_EXIT;
+        }
+
+        if (m_size > 0) {
+            if (m_error || m_size >= m_capacity / 2 || Clock::now() >= m_readyTime) {
+                break;
+            }
+            m_cond.wait_until(lock, m_readyTime);
+        } else {
+            if (m_error) {
+                return m_error;
+            }
+            m_cond.wait(lock);
+        }
+    }
+
+    size_t n = std::min(static_cast<size_t>(size), m_size);
+    size_t first = std::min(n, m_capacity - m_head);
+    memcpy(buf, &m_ring[m_head], first);
+    memcpy(buf + first, &m_ring[0], n - first);
+
+    m_head = (m_head + n) % m_capacity;
+    m_size -= n;
+    if (m_size == 0) {
+        m_emptySince = Clock::now();
+    }
+
+    // Free space for the reader
+    m_cond.notify_all();
+
+    return static_cast<int>(n);
+}
+
+// NOTE: Executes in the reader thread context
+QmlAVLoopController QmlAVReadAheadIO::fill()
+{
+    size_t space;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_cond.wait(lock, [&] {
+            // Executes in lock context
+            return m_stopRequested || m_size < m_capacity;
+        });
+
+        if (m_stopRequested) {
+            return QmlAVLoopController::Break;
+        }
+
+        space = m_capacity - m_size;
+    }
+
+    // The lock is not held while the network blocks
+    resetTimer();
+    int ret = avio_read_partial(m_protocolCtx, m_chunk.data(), static_cast<int>(std::min(space, m_chunk.size())));
+
+    std::scoped_lock lock(m_mutex);
+
+    if (ret <= 0) {
+        if (ret == 0 && !avio_feof(m_protocolCtx)) {
+            return QmlAVLoopController::Continue;
+        }
+
+        // The demuxer gets it after the buffered data
+        m_error = ret < 0 ? ret : AVERROR_EOF;
+        m_cond.notify_all();
+        return QmlAVLoopController::Break;
+    }
+
+    auto now = Clock::now();
+    if (m_size == 0 && now - m_emptySince > m_delay) {
+        m_readyTime = now + m_delay;
+    }
+
+    size_t n = static_cast<size_t>(ret);
+    size_t tail = (m_head + m_size) % m_capacity;
+    size_t first = std::min(n, m_capacity - tail);
+    memcpy(&m_ring[tail], m_chunk.data(), first);
+    memcpy(&m_ring[0], m_chunk.data() + first, n - first);
+    m_size += n;
+
+    m_cond.notify_all();
+
+    return QmlAVLoopController::Continue;
+}
+
+// Each network read (or the open) may take up to the timeout
+void QmlAVReadAheadIO::resetTimer()
+{
+    m_expireTime = m_timeout > 0 ? av_gettime_relative() + m_timeout : 0;
+}
@@ -0,0 +1,79 @@
+#ifndef QMLAVREADAHEAD_H
+#define QMLAVREADAHEAD_H
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <QString>
+
+#include "qmlavthread.h"
+
+class QmlAVOptions;
+class QmlAVInterruptCallback;
+
+// AVIOContext reading from a ring buffer that a dedicated thread keeps filling from the network,
+// so the demuxer doesn't stall on the socket reads and the network jitter is absorbed before demuxing.
+// Initially and after an outage (the buffer stayed empty longer than the delay), the reads wait
+// for the buffer to fill up for the delay. The short gaps between the network packets don't count.
+// NOTE: Byte stream protocols only (HTTP, TCP, UDP, SRT, RTMP...), the RTSP/RTP demuxers read their sockets themselves.
+class QmlAVReadAheadIO
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // The interrupt request of the demuxer aborts the network reads as well. Its timer doesn't: the demuxer thread
+    // resets it per packet, the network reads have their own timeout (us, none if 0) instead.
+    QmlAVReadAheadIO(size_t size, int64_t delay, int64_t timeout, const QmlAVInterruptCallback &interruptCallback);
+    virtual ~QmlAVReadAheadIO();
+
+    QmlAVReadAheadIO(const QmlAVReadAheadIO &other) = delete;
+    QmlAVReadAheadIO &operator=(const QmlAVReadAheadIO &other) = delete;
+
+    // Opens the protocol and starts the reader thread
+    bool open(const QString &url, const QmlAVOptions &avOptions);
+    // For AVFormatContext::pb, the caller keeps this object alive until the format context is closed
+    AVIOContext *avioContext() const { return m_avioCtx; }
+
+protected:
+    static int readPacket(void *opaque, uint8_t *buf, int size);
+    int read(uint8_t *buf, int size);
+    QmlAVLoopController fill();
+    void resetTimer();
+
+private:
+    const size_t m_capacity;
+    const std::chrono::microseconds m_delay;
+    const int64_t m_timeout;
+
+    AVIOInterruptCB m_interruptCallback;
+    const QmlAVInterruptCallback &m_parentInterruptCallback;
+    std::atomic<bool> m_stopRequested;
+    int64_t m_expireTime; // The thread reading the network only (the opening one, then the reader thread)
+
+    AVIOContext *m_protocolCtx; // The network
+    AVIOContext *m_avioCtx;     // The demuxer
+
+    // Everything below is guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    std::vector<uint8_t> m_ring;
+    size_t m_head; // Read position
+    size_t m_size;
+    Clock::time_point m_emptySince;
+    Clock::time_point m_readyTime; // Filling up until then
+    int m_error;   // AVERROR_EOF or the error of the network read, reported once the buffer is drained
+
+    std::vector<uint8_t> m_chunk; // Reader thread only
+
+    QmlAVThreadLiveController<QmlAVLoopController> m_readerThread;
+};
+
+#endif // QMLAVREADAHEAD_H
@@ -0,0 +1,285 @@
+#include "qmlavrecorder.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+QmlAVRecorder::QmlAVRecorder(const QString &url, const QmlAVOptions &avOptions)
+    : m_url(url)
+    , m_avOptions(avOptions)
+    , m_hasVideo(false)
+    , m_dropUntilKeyFrame(false)
+    , m_queueLimit({avOptions.recordQueueSize(), 0})
+    , m_outputCtx(nullptr)
+    , m_headerWritten(false)
+    , m_rebase(true)
+    , m_offset(0)
+    , m_endTime(0)
+    , m_failed(false)
+    , m_stopped(false)
+    , m_threadTask(&QmlAVRecorder::worker)
+{
+    m_threadTask.argsQueue()->setWeigher([](const auto &args) {
+        return QmlAVQueueWeight{std::get<AVPacketPtr>(args)->size, 0};
+    });
+}
+
+QmlAVRecorder::~QmlAVRecorder()
+{
+    stop();
+    m_thread.waitForFinished();
+
+    // Not started or the writer thread has been interrupted
+    closeOutput();
+
+    for (auto &stream : m_streams) {
+        avcodec_parameters_free(&stream.codecPar);
+    }
+}
+
+void QmlAVRecorder::addStream(QmlAVDecoder::Type type, const AVCodecParameters *codecPar, AVRational timeBase)
+{
+    Stream &stream = m_streams[type];
+
+    if (!stream.codecPar) {
+        stream.codecPar = avcodec_parameters_alloc();
+    }
+    avcodec_parameters_copy(stream.codecPar, codecPar);
+    stream.timeBase = timeBase;
+}
+
+void QmlAVRecorder::start()
+{
+    m_hasVideo = m_streams[QmlAVDecoder::TypeVideo].codecPar != nullptr;
+    m_dropUntilKeyFrame = m_hasVideo;
+
+    // Dedicated, the writes block on the output I/O
+    m_thread = m_threadTask.getLiveController();
+}
+
+void QmlAVRecorder::stop()
+{
+    if (m_stopped) {
+        return;
+    }
+    m_stopped = true;
+
+    m_threadTask(this, Finish, QmlAVDecoder::TypeUnknown, AVPacketPtr());
+}
+
+void QmlAVRecorder::write(QmlAVDecoder::Type type, const AVPacketPtr &avPacket)
+{
+    if (m_failed || m_stopped || !m_streams[type].codecPar) {
+        return;
+    }
+
+    bool keyFrame = type == QmlAVDecoder::TypeVideo && (avPacket->flags & AV_PKT_FLAG_KEY);
+    if (m_dropUntilKeyFrame) {
+        if (!keyFrame) {
+            m_counters.packetsDropped++;
+            return;
+        }
+        m_dropUntilKeyFrame = false;
+    }
+
+    // NOTE: The only producer, the queue may only get lighter meanwhile
+    if (!m_threadTask.argsQueue()->weight().isBelow(m_queueLimit)) {
+        logDebug() << "Recording queue overflow, dropping up to the next keyframe";
+        m_counters.packetsDropped++;
+        m_dropUntilKeyFrame = m_hasVideo;
+        return;
+    }
+
+    m_threadTask(this, Write, type, avPacket);
+}
+
+void QmlAVRecorder::discontinuity()
+{
+    if (m_failed || m_stopped) {
+        return;
+    }
+
+    // The new input starts anywhere in the GOP
+    m_dropUntilKeyFrame = m_hasVideo;
+    m_threadTask(this, Discontinuity, QmlAVDecoder::TypeUnknown, AVPacketPtr());
+}
+
+// NOTE: Executes in the writer thread context
+QmlAVLoopController QmlAVRecorder::worker(Command command, QmlAVDecoder::Type type, const AVPacketPtr &avPacket)
+{
+    switch (command) {
+    case Finish:
+        closeOutput();
+        return QmlAVLoopController::Break;
+    case Discontinuity:
+        m_rebase = true;
+        return QmlAVLoopController::Continue;
+    case Write:
+        break;
+    }
+
+    if (!m_outputCtx && !openOutput()) {
+        fail();
+        return QmlAVLoopController::Break;
+    }
+
+    if (!writePacket(type, avPacket)) {
+        fail();
+        return QmlAVLoopController::Break;
+    }
+
+    return QmlAVLoopController::Continue;
+}
+
+bool QmlAVRecorder::openOutput()
+{
+    int ret = avformat_alloc_output_context2(&m_outputCtx, m_avOptions.avOutputFormat(), nullptr, m_url.toUtf8());
+    if (ret < 0) {
+        logWarning() << QString("Unable to create output: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+        return false;
+    }
+
+    for (auto &stream : m_streams) {
+        if (!stream.codecPar) {
+            continue;
+        }
+
+        AVStream *avStream = avformat_new_stream(m_outputCtx, nullptr);
+        if (!avStream || avcodec_parameters_copy(avStream->codecpar, stream.codecPar) < 0) {
+            logWarning() << "Unable to create output stream";
+            return false;
+        }
+
+        // The tag of the input container may be invalid in the output one
+        avStream->codecpar->codec_tag = 0;
+        avStream->time_base = stream.timeBase;
+        stream.index = avStream->index;
+    }
+
+    AVDictionaryPtr dict = static_cast<AVDictionaryPtr>(m_avOptions);
+    dict.remove("f");
+    dict.remove("record_queue_size");
+
+    if (!(m_outputCtx->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open2(&m_outputCtx->pb, m_url.toUtf8(), AVIO_FLAG_WRITE, nullptr, dict);
+        if (ret < 0) {
+            logWarning() << QString("Unable to open output file: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+            return false;
+        }
+    }
+
+    ret = avformat_write_header(m_outputCtx, dict);
+    if (ret < 0) {
+        logWarning() << QString("Unable to write output header: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+        return false;
+    }
+    m_headerWritten = true;
+
+    logDebug() << "avformat_write_header() options ignored: " << QmlAV::Quote << dict.toString();
+    logInfo() << "Recording to " << QmlAV::Quote << m_url;
+
+    return true;
+}
+
+void QmlAVRecorder::closeOutput()
+{
+    if (!m_outputCtx) {
+        return;
+    }
+
+    if (m_headerWritten) {
+        int ret = av_write_trailer(m_outputCtx);
+        if (ret < 0) {
+            logWarning() << QString("Unable to write output trailer: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+        }
+
+        logInfo() << QString("Recording finished: %1 packets written, %2 dropped")
+                     .arg(m_counters.packetsWritten.get()).arg(m_counters.packetsDropped.get());
+    }
+
+    if (!(m_outputCtx->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&m_outputCtx->pb);
+    }
+
+    avformat_free_context(m_outputCtx);
+    m_outputCtx = nullptr;
+    m_headerWritten = false;
+}
+
+// Shifts the timestamps to the recording timeline, which starts from zero
+// and continues from the end of the written packets after a discontinuity
+bool QmlAVRecorder::writePacket(QmlAVDecoder::Type type, const AVPacketPtr &avPacket)
+{
+    Stream &stream = m_streams[type];
+    const AVStream *avStream = m_outputCtx->streams[stream.index];
+
+    // The muxer takes over the packet
+    AVPacketPtr packet = avPacket;
+
+    int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    if (m_rebase && ts != AV_NOPTS_VALUE) {
+        m_offset = m_endTime - av_rescale_q(ts, stream.timeBase, AV_TIME_BASE_Q);
+        m_rebase = false;
+    }
+
+    if (m_rebase) {
+        // Nothing to align the timeline to
+        m_counters.packetsDropped++;
+        return true;
+    }
+
+    const int64_t offset = av_rescale_q(m_offset, AV_TIME_BASE_Q, stream.timeBase);
+    if (packet->pts != AV_NOPTS_VALUE) {
+        packet->pts += offset;
+    }
+    if (packet->dts != AV_NOPTS_VALUE) {
+        packet->dts += offset;
+    }
+
+    ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    if (ts != AV_NOPTS_VALUE) {
+        // E.g. the audio demuxed just before the first keyframe
+        if (ts < 0) {
+            m_counters.packetsDropped++;
+            return true;
+        }
+
+        m_endTime = std::max(m_endTime, av_rescale_q(ts + std::max<int64_t>(packet->duration, 1), stream.timeBase, AV_TIME_BASE_Q));
+    }
+
+    av_packet_rescale_ts(packet, stream.timeBase, avStream->time_base);
+
+    // The muxers reject non-monotonic DTS, e.g. of the overlapping packets after a reconnect
+    if (packet->dts != AV_NOPTS_VALUE) {
+        if (stream.lastDts != AV_NOPTS_VALUE && packet->dts <= stream.lastDts) {
+            m_counters.packetsDropped++;
+            return true;
+        }
+        stream.lastDts = packet->dts;
+    }
+
+    packet->stream_index = stream.index;
+    packet->pos = -1;
+
+    int ret = av_interleaved_write_frame(m_outputCtx, packet);
+    if (ret < 0) {
+        logWarning() << QString("Unable to write packet: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+        return false;
+    }
+
+    m_counters.packetsWritten++;
+
+    return true;
+}
+
+void QmlAVRecorder::fail()
+{
+    m_failed = true;
+    closeOutput();
+
+    if (m_errorHandler) {
+        m_errorHandler();
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef QMLAVRECORDER_H
+#define QMLAVRECORDER_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <array>
+#include <functional>
+
+#include <QString>
+
+#include "qmlavoptions.h"
+#include "qmlavthread.h"
+#include "qmlavdecoder.h"
+
+// Tee of the demuxed packets into a muxer (MP4, MKV, segmented TS...) without re-encoding, so recording
+// a source doesn't take a second connection to it. The packets are written by a dedicated thread
+// from a queue bounded by size, the demuxer never waits for the output: on overflow the packets are dropped
+// up to the next video keyframe. The recording starts with a video keyframe, the timestamps start from zero.
+// NOTE: One recorder per recording, the output is opened by the writer thread on the first packet.
+class QmlAVRecorder
+{
+public:
+    struct Counters {
+        QmlAVRelaxedAtomic<uint32_t> packetsWritten = 0;
+        QmlAVRelaxedAtomic<uint32_t> packetsDropped = 0;
+    };
+
+    // Called from the writer thread once the recording has failed
+    using ErrorHandler = std::function<void()>;
+
+    QmlAVRecorder(const QString &url, const QmlAVOptions &avOptions);
+    virtual ~QmlAVRecorder();
+
+    QmlAVRecorder(const QmlAVRecorder &other) = delete;
+    QmlAVRecorder &operator=(const QmlAVRecorder &other) = delete;
+
+    // NOTE: Before start() only!
+    void addStream(QmlAVDecoder::Type type, const AVCodecParameters *codecPar, AVRational timeBase);
+    void setErrorHandler(ErrorHandler handler) { m_errorHandler = std::move(handler); }
+
+    void start();
+    // The queued packets are written out and the output is finalized asynchronously (see isFinished())
+    void stop();
+    bool isFinished() const { return !m_thread.isRunning(); }
+
+    // NOTE: Demuxer thread only!
+    void write(QmlAVDecoder::Type type, const AVPacketPtr &avPacket);
+    // The input has been reconnected, the timestamps continue from the end of the written ones
+    void discontinuity();
+
+    const auto &counters() const { return m_counters; }
+
+protected:
+    enum Command {
+        Write,
+        Discontinuity,
+        Finish
+    };
+
+    QmlAVLoopController worker(Command command, QmlAVDecoder::Type type, const AVPacketPtr &avPacket);
+    bool openOutput();
+    void closeOutput();
+    bool writePacket(QmlAVDecoder::Type type, const AVPacketPtr &avPacket);
+    void fail();
+
+private:
+    struct Stream {
+        AVCodecParameters *codecPar = nullptr;
+        AVRational timeBase = {0, 1};
+        int index = -1;                  // Of the output
+        int64_t lastDts = AV_NOPTS_VALUE; // In the output time base
+    };
+
+    const QString m_url;
+    const QmlAVOptions m_avOptions;
+    ErrorHandler m_errorHandler;
+
+    std::array<Stream, QmlAVDecoder::TypeAudio + 1> m_streams;
+    bool m_hasVideo;
+
+    // Demuxer thread context only
+    bool m_dropUntilKeyFrame;
+    QmlAVQueueWeight m_queueLimit;
+
+    // Writer thread context only
+    AVFormatContext *m_outputCtx;
+    bool m_headerWritten;
+    bool m_rebase;
+    int64_t m_offset;  // AV_TIME_BASE
+    int64_t m_endTime; // AV_TIME_BASE
+
+    QmlAVRelaxedAtomic<bool> m_failed;
+    QmlAVRelaxedAtomic<bool> m_stopped;
+
+    QmlAVThreadTask<decltype(&QmlAVRecorder::worker)> m_threadTask;
+    QmlAVThreadLiveController<QmlAVLoopController> m_thread;
+
+    Counters m_counters;
+};
+
+#endif // QMLAVRECORDER_H
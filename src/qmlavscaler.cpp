@@ -0,0 +1,234 @@
+#include "qmlavscaler.h"
+#include "qmlavformat.h"
+#include "qmlavoptions.h"
+
+#include <algorithm>
+#include <atomic>
+
+extern "C" {
+#include <libswscale/swscale.h>
+#include <libavutil/cpu.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+}
+
+#define SWS_CONTEXTS_LIMIT 4 // Idle contexts, e.g. while the render size is changing
+#define SWS_AUTO_THREADS_LIMIT 4 // The conversion is bound by memory bandwidth rather than by the cores
+
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+#define SWS_THREADS_SUPPORTED
+#endif
+
+namespace {
+
+// Scalers that have converted with swscale in the process, see QmlAVOptions::AutoThreadCount
+std::atomic<int> s_activeScalers = 0;
+
+// Scalar chroma decimation by the rounded average of the row pairs, the 2x2 blocks respectively.
+// Close to the swscale output of the same conversion (see the tests), just without building its filters.
+void halveRows(const uint8_t *src, int srcLinesize, int srcHeight, uint8_t *dst, int dstLinesize, int width, int dstHeight)
+{
+    for (int y = 0; y < dstHeight; ++y) {
+        const uint8_t *row0 = src + 2 * y * srcLinesize;
+        const uint8_t *row1 = 2 * y + 1 < srcHeight ? row0 + srcLinesize : row0;
+        uint8_t *out = dst + y * dstLinesize;
+
+        for (int x = 0; x < width; ++x) {
+            out[x] = (row0[x] + row1[x] + 1) >> 1;
+        }
+    }
+}
+
+void halveRowsAndColumns(const uint8_t *src, int srcLinesize, int srcWidth, int srcHeight, uint8_t *dst, int dstLinesize, int dstHeight)
+{
+    for (int y = 0; y < dstHeight; ++y) {
+        const uint8_t *row0 = src + 2 * y * srcLinesize;
+        const uint8_t *row1 = 2 * y + 1 < srcHeight ? row0 + srcLinesize : row0;
+        uint8_t *out = dst + y * dstLinesize;
+
+        int x = 0;
+        for (; x < srcWidth / 2; ++x) {
+            out[x] = (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) >> 2;
+        }
+        if (srcWidth & 1) {
+            out[x] = (row0[2 * x] + row1[2 * x] + 1) >> 1;
+        }
+    }
+}
+
+} // namespace
+
+QmlAVScaler::QmlAVScaler(QmlAVFramePool &framePool)
+    : m_framePool(framePool)
+    , m_threadCount(QmlAVOptions::AutoThreadCount)
+    , m_flags(SWS_BILINEAR)
+    , m_active(false)
+{
+}
+
+QmlAVScaler::~QmlAVScaler()
+{
+    for (auto &[key, swsCtx] : m_swsContexts) {
+        sws_freeContext(swsCtx);
+    }
+
+    if (m_active) {
+        --s_activeScalers;
+    }
+}
+
+AVFramePtr QmlAVScaler::scale(const AVFramePtr &srcFrame, int dstWidth, int dstHeight, AVPixelFormat dstFormat)
+{
+    AVPixelFormat srcFormat = QmlAVPixelFormat(srcFrame->format); // Normalize
+
+    if (srcFrame->width == dstWidth && srcFrame->height == dstHeight) {
+        if (AVFramePtr dstFrame = repack(srcFrame, srcFormat, dstFormat)) {
+            return dstFrame;
+        }
+    }
+
+    Key key = {srcFrame->width, srcFrame->height, srcFormat, dstWidth, dstHeight, dstFormat};
+    SwsContext *swsCtx = acquire(key);
+    if (!swsCtx) {
+        return AVFramePtr();
+    }
+
+    AVFramePtr dstFrame = m_framePool.frame(dstWidth, dstHeight, dstFormat);
+    if (dstFrame) {
+#ifdef SWS_THREADS_SUPPORTED
+        // NOTE: Unlike sws_scale(), sws_scale_frame() spreads the slices over the context threads
+        AVFramePtr src = srcFrame;
+        src->format = srcFormat;
+
+        int ret = sws_scale_frame(swsCtx, dstFrame, src);
+        if (ret < 0) {
+            logWarning() << QString("Failed to scale the frame: \"%1\" (%2)").arg(av_err2str(ret)).arg(ret);
+            dstFrame.unref();
+        }
+#else
+        sws_scale(swsCtx, srcFrame->data, srcFrame->linesize, 0, srcFrame->height, dstFrame->data, dstFrame->linesize);
+#endif
+        if (dstFrame) {
+            av_frame_copy_props(dstFrame, srcFrame);
+        }
+    }
+
+    release(key, swsCtx);
+
+    return dstFrame;
+}
+
+// Same size planar YUV conversions only differ by the chroma subsampling and don't need the swscale filter pipeline.
+// Returns an empty frame if there is no such path for the formats.
+AVFramePtr QmlAVScaler::repack(const AVFramePtr &srcFrame, AVPixelFormat srcFormat, AVPixelFormat dstFormat)
+{
+    if (dstFormat != AV_PIX_FMT_YUV420P || (srcFormat != AV_PIX_FMT_YUV422P && srcFormat != AV_PIX_FMT_YUV444P)) {
+        return AVFramePtr();
+    }
+
+    int width = srcFrame->width;
+    int height = srcFrame->height;
+
+    AVFramePtr dstFrame = m_framePool.frame(width, height, dstFormat);
+    if (!dstFrame) {
+        return dstFrame;
+    }
+
+    av_image_copy_plane(dstFrame->data[0], dstFrame->linesize[0], srcFrame->data[0], srcFrame->linesize[0], width, height);
+
+    int chromaWidth = (width + 1) >> 1;
+    int chromaHeight = (height + 1) >> 1;
+
+    for (int i = 1; i <= 2; ++i) {
+        if (srcFormat == AV_PIX_FMT_YUV422P) {
+            halveRows(srcFrame->data[i], srcFrame->linesize[i], height, dstFrame->data[i], dstFrame->linesize[i], chromaWidth, chromaHeight);
+        } else {
+            halveRowsAndColumns(srcFrame->data[i], srcFrame->linesize[i], width, height, dstFrame->data[i], dstFrame->linesize[i], chromaHeight);
+        }
+    }
+
+    av_frame_copy_props(dstFrame, srcFrame);
+
+    return dstFrame;
+}
+
+SwsContext *QmlAVScaler::acquire(const Key &key)
+{
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (!m_active) {
+            m_active = true;
+            ++s_activeScalers;
+        }
+
+        auto it = m_swsContextsIndex.find(key);
+        if (it != m_swsContextsIndex.end()) {
+            SwsContext *swsCtx = it->second->second;
+            m_swsContexts.erase(it->second);
+            m_swsContextsIndex.erase(it);
+            return swsCtx;
+        }
+    }
+
+    const auto &[srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat] = key;
+
+    SwsContext *swsCtx = sws_alloc_context();
+    if (swsCtx) {
+        av_opt_set_int(swsCtx, "srcw", srcWidth, 0);
+        av_opt_set_int(swsCtx, "srch", srcHeight, 0);
+        av_opt_set_int(swsCtx, "src_format", srcFormat, 0);
+        av_opt_set_int(swsCtx, "dstw", dstWidth, 0);
+        av_opt_set_int(swsCtx, "dsth", dstHeight, 0);
+        av_opt_set_int(swsCtx, "dst_format", dstFormat, 0);
+        av_opt_set_int(swsCtx, "sws_flags", m_flags, 0);
+#ifdef SWS_THREADS_SUPPORTED
+        int threads = m_threadCount;
+        if (threads == QmlAVOptions::AutoThreadCount) {
+            // Every cached context keeps its own threads, so a wall of tiles gets a single one per context
+            threads = std::clamp(av_cpu_count() / std::max(1, s_activeScalers.load()), 1, SWS_AUTO_THREADS_LIMIT);
+        }
+        av_opt_set_int(swsCtx, "threads", threads, 0);
+#endif
+
+        if (sws_init_context(swsCtx, nullptr, nullptr) < 0) {
+            sws_freeContext(swsCtx);
+            swsCtx = nullptr;
+        }
+    }
+
+    if (!swsCtx) {
+        logWarning() << "Unable to create the scaling context";
+    }
+
+    return swsCtx;
+}
+
+void QmlAVScaler::release(const Key &key, SwsContext *swsCtx)
+{
+    SwsContext *evicted = nullptr;
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        // Evict the least recently used context, the released one is the most likely to be used again
+        if (m_swsContexts.size() >= SWS_CONTEXTS_LIMIT) {
+            auto lru = std::prev(m_swsContexts.end());
+            auto range = m_swsContextsIndex.equal_range(lru->first);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == lru) {
+                    m_swsContextsIndex.erase(it);
+                    break;
+                }
+            }
+
+            evicted = lru->second;
+            m_swsContexts.erase(lru);
+        }
+
+        m_swsContexts.emplace_front(key, swsCtx);
+        m_swsContextsIndex.emplace(key, m_swsContexts.begin());
+    }
+
+    sws_freeContext(evicted);
+}
@@ -0,0 +1,65 @@
+#ifndef QMLAVSCALER_H
+#define QMLAVSCALER_H
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+#include <mutex>
+#include <list>
+#include <map>
+#include <tuple>
+
+#include "qmlavutils.h"
+#include "qmlavframepool.h"
+
+struct SwsContext;
+
+// Video counterpart of QmlAVResampler shared by the decoder and render threads.
+// The scaling contexts (and their filter tables) are cached by the source/destination size and format,
+// so the frames of a stream don't have to rebuild them. The output frames come from the stream frame pool.
+// A frame is converted in horizontal slices on the swscale own worker threads where supported (FFmpeg 5.0+).
+// Same size chroma resampling of planar YUV bypasses swscale entirely.
+class QmlAVScaler
+{
+public:
+    QmlAVScaler(QmlAVFramePool &framePool);
+    virtual ~QmlAVScaler();
+
+    QmlAVScaler(const QmlAVScaler &other) = delete;
+    QmlAVScaler &operator=(const QmlAVScaler &other) = delete;
+
+    // NOTE: Thread safe. Returns an empty frame on failure.
+    AVFramePtr scale(const AVFramePtr &srcFrame, int dstWidth, int dstHeight, AVPixelFormat dstFormat);
+
+    // Slices per frame, QmlAVOptions::AutoThreadCount by default.
+    // NOTE: Affects the contexts created after the call only.
+    int threadCount() const { return m_threadCount; }
+    void setThreadCount(int count) { m_threadCount = count; }
+    // SWS_* flags, SWS_BILINEAR by default.
+    // NOTE: Affects the contexts created after the call only.
+    int flags() const { return m_flags; }
+    void setFlags(int flags) { m_flags = flags; }
+
+protected:
+    using Key = std::tuple<int, int, AVPixelFormat, int, int, AVPixelFormat>;
+
+    AVFramePtr repack(const AVFramePtr &srcFrame, AVPixelFormat srcFormat, AVPixelFormat dstFormat);
+    SwsContext *acquire(const Key &key);
+    void release(const Key &key, SwsContext *swsCtx);
+
+private:
+    QmlAVFramePool &m_framePool;
+    QmlAVRelaxedAtomic<int> m_threadCount;
+    QmlAVRelaxedAtomic<int> m_flags;
+
+    using Contexts = std::list<std::pair<Key, SwsContext *>>;
+
+    std::mutex m_mutex;
+    bool m_active; // Counted in the auto thread count
+    // Idle contexts from the most recently released one, a busy one is owned by the scaling thread
+    Contexts m_swsContexts;
+    std::multimap<Key, Contexts::iterator> m_swsContextsIndex;
+};
+
+#endif // QMLAVSCALER_H
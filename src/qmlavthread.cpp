@@ -1,5 +1,240 @@
 #include "qmlavthread.h"
 
+namespace {
+// Identifies the pool thread for scheduling into its local queue
+thread_local const QmlAVThreadPool *t_pool = nullptr;
+thread_local size_t t_index = 0;
+}
+
+QmlAVThreadPool &QmlAVThreadPool::instance()
+{
+    // At least two threads, so that a single pooled worker can't stall the rest
+    static QmlAVThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+QmlAVThreadPool::QmlAVThreadPool(size_t size)
+    : m_stopped(false)
+    , m_idleCount(0)
+    , m_nextDeadline(Clock::time_point::max().time_since_epoch().count())
+{
+    for (size_t i = 0; i < size; ++i) {
+        m_localQueues.push_back(std::make_unique<LocalQueue>());
+    }
+    for (size_t i = 0; i < size; ++i) {
+        m_threads.emplace_back(&QmlAVThreadPool::run, this, i);
+    }
+}
+
+QmlAVThreadPool::~QmlAVThreadPool()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stopped = true;
+    }
+    m_cond.notify_all();
+
+    for (auto &t : m_threads) {
+        t.join();
+    }
+}
+
+void QmlAVThreadPool::schedule(WorkerRef thread, Clock::time_point deadline)
+{
+    if (deadline > Clock::now()) {
+        {
+            std::scoped_lock lock(m_mutex);
+
+            auto it = m_timers.emplace(deadline, std::move(thread));
+            if (it == m_timers.begin()) {
+                m_nextDeadline = deadline.time_since_epoch().count();
+            }
+        }
+
+        // A new timer may be earlier than the one the idle threads are waiting for
+        m_cond.notify_one();
+        return;
+    }
+
+    if (t_pool == this) {
+        auto &local = *m_localQueues[t_index];
+        {
+            std::scoped_lock lock(local.mutex);
+            local.queue.push_back(std::move(thread));
+        }
+
+        // Let an idle thread steal it
+        notifyIdle();
+        return;
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_injectionQueue.push_back(std::move(thread));
+    }
+    m_cond.notify_one();
+}
+
+void QmlAVThreadPool::expire(WorkerRef thread, Clock::time_point deadline)
+{
+    bool found = false;
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        auto range = m_timers.equal_range(deadline);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (!it->second.owner_before(thread) && !thread.owner_before(it->second)) {
+                m_timers.erase(it);
+                found = true;
+                break;
+            }
+        }
+    }
+
+    // Otherwise the timer has already expired
+    if (found) {
+        schedule(std::move(thread));
+    }
+}
+
+void QmlAVThreadPool::run(size_t index)
+{
+    t_pool = this;
+    t_index = index;
+
+    while (auto thread = next(index)) {
+        thread->step();
+        thread.reset(); // The last reference may be released here, outside the locks
+    }
+}
+
+std::shared_ptr<QmlAVWorkerThread> QmlAVThreadPool::next(size_t index)
+{
+    auto pop = [](LocalQueue &local, bool steal) -> std::shared_ptr<QmlAVWorkerThread> {
+        std::scoped_lock lock(local.mutex);
+
+        while (!local.queue.empty()) {
+            std::shared_ptr<QmlAVWorkerThread> thread;
+            if (steal) {
+                thread = local.queue.back().lock();
+                local.queue.pop_back();
+            } else {
+                thread = local.queue.front().lock();
+                local.queue.pop_front();
+            }
+
+            // Skip workers that have been destroyed while queued
+            if (thread) {
+                return thread;
+            }
+        }
+
+        return nullptr;
+    };
+
+    while (!m_stopped) {
+        expireTimers(index);
+
+        if (auto thread = pop(*m_localQueues[index], false)) {
+            return thread;
+        }
+
+        {
+            std::scoped_lock lock(m_mutex);
+
+            while (!m_injectionQueue.empty()) {
+                auto thread = m_injectionQueue.front().lock();
+                m_injectionQueue.pop_front();
+                if (thread) {
+                    return thread;
+                }
+            }
+        }
+
+        for (size_t i = 1; i < m_localQueues.size(); ++i) {
+            if (auto thread = pop(*m_localQueues[(index + i) % m_localQueues.size()], true)) {
+                return thread;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // NOTE: The counter is incremented before the queues are rechecked, see notifyIdle()
+        ++m_idleCount;
+        if (!m_stopped && !hasWork()) {
+            if (m_timers.empty()) {
+                m_cond.wait(lock);
+            } else {
+                m_cond.wait_until(lock, m_timers.begin()->first);
+            }
+        }
+        --m_idleCount;
+    }
+
+    return nullptr;
+}
+
+// NOTE: Executes in m_mutex lock context
+bool QmlAVThreadPool::hasWork() const
+{
+    if (!m_injectionQueue.empty()) {
+        return true;
+    }
+    if (!m_timers.empty() && m_timers.begin()->first <= Clock::now()) {
+        return true;
+    }
+
+    for (const auto &local : m_localQueues) {
+        std::scoped_lock lock(local->mutex);
+        if (!local->queue.empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Move expired timers to the local queue of the calling thread
+void QmlAVThreadPool::expireTimers(size_t index)
+{
+    auto now = Clock::now();
+    if (now.time_since_epoch().count() < m_nextDeadline.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    bool expired = false;
+    {
+        std::scoped_lock lock(m_mutex);
+        auto &local = *m_localQueues[index];
+        std::scoped_lock localLock(local.mutex);
+
+        while (!m_timers.empty() && m_timers.begin()->first <= now) {
+            local.queue.push_back(std::move(m_timers.begin()->second));
+            m_timers.erase(m_timers.begin());
+            expired = true;
+        }
+
+        m_nextDeadline = (m_timers.empty() ? Clock::time_point::max() : m_timers.begin()->first).time_since_epoch().count();
+    }
+
+    if (expired) {
+        notifyIdle();
+    }
+}
+
+void QmlAVThreadPool::notifyIdle()
+{
+    // The idle thread rechecks the queues after the counter increment under m_mutex,
+    // so taking the lock here guarantees it is either waiting already or will see the new work.
+    if (m_idleCount.load() > 0) {
+        {
+            std::scoped_lock lock(m_mutex);
+        }
+        m_cond.notify_one();
+    }
+}
+
 void QmlAVWorkerThread::requestInterrupt()
 {
     if (m_worker) {
@@ -7,6 +242,47 @@ void QmlAVWorkerThread::requestInterrupt()
     }
 
     m_loopInterruptRequested.store(true, std::memory_order_release);
+
+    // Waiting or parked worker has to be resumed to finish
+    wake();
+}
+
+void QmlAVWorkerThread::wake()
+{
+    QmlAVThreadPool::Clock::time_point timerDeadline;
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (!m_running) {
+            return;
+        }
+
+        m_wakePending = true;
+
+        if (m_policy != Pooled) {
+            m_wakeCond.notify_all();
+            return;
+        }
+
+        if (m_scheduled) {
+            // Sleeping on the pool timer can only be shortened by waitUntil() or interruption
+            if (m_timerWakeable || m_loopInterruptRequested.load(std::memory_order_acquire)) {
+                std::swap(timerDeadline, m_timerDeadline);
+            }
+            if (timerDeadline == QmlAVThreadPool::Clock::time_point{}) {
+                return;
+            }
+        } else {
+            m_scheduled = true;
+        }
+    }
+
+    if (timerDeadline != QmlAVThreadPool::Clock::time_point{}) {
+        QmlAVThreadPool::instance().expire(weak_from_this(), timerDeadline);
+    } else {
+        QmlAVThreadPool::instance().schedule(weak_from_this());
+    }
 }
 
 void QmlAVWorkerThread::run()
@@ -20,8 +296,9 @@ void QmlAVWorkerThread::run()
                 break;
             }
 
-            std::this_thread::yield();
-            ctrl.sleep();
+            if (ctrl.isWait() || ctrl.hasDeadline()) {
+                sleep(ctrl);
+            }
         }
     } catch (const std::exception &e) {
         logWarning() << QString("Exception thrown in worker thread: %1").arg(e.what());
@@ -29,6 +306,93 @@ void QmlAVWorkerThread::run()
         logWarning() << "Unknown exception thrown in worker thread";
     }
 
-    setRunning(false);
+    finish();
+}
+
+// Blocks the dedicated thread according to the loop controller, interruptible at any time
+void QmlAVWorkerThread::sleep(const QmlAVLoopController &ctrl)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto isReady = [&] {
+        // Executes in lock context
+        return m_loopInterruptRequested.load(std::memory_order_acquire) || (ctrl.isWait() && m_wakePending);
+    };
+
+    if (ctrl.hasDeadline()) {
+        m_wakeCond.wait_until(lock, ctrl.deadline(), isReady);
+    } else {
+        m_wakeCond.wait(lock, isReady);
+    }
+
+    if (ctrl.isWait()) {
+        m_wakePending = false;
+    }
+}
+
+// Single loop iteration on the pool thread
+void QmlAVWorkerThread::step()
+{
+    assert(m_worker);
+
+    QmlAVLoopController ctrl = QmlAVLoopController::Break;
+
+    try {
+        if (!m_loopInterruptRequested.load(std::memory_order_acquire)) {
+            ctrl = m_worker->invoke();
+        }
+    } catch (const std::exception &e) {
+        logWarning() << QString("Exception thrown in pooled worker: %1").arg(e.what());
+    } catch (...) {
+        logWarning() << "Unknown exception thrown in pooled worker";
+    }
+
+    if (ctrl.isBreak()) {
+        finish();
+        return;
+    }
+
+    QmlAVThreadPool::Clock::time_point deadline;
+
+    {
+        std::scoped_lock lock(m_mutex);
+
+        bool park = false;
+        if (ctrl.isWait()) {
+            park = !m_wakePending && !ctrl.hasDeadline();
+            deadline = m_wakePending ? QmlAVThreadPool::Clock::time_point{} : ctrl.deadline();
+        } else {
+            park = ctrl.isContinue() && !m_wakePending && m_worker->isIdle();
+            deadline = ctrl.deadline();
+        }
+
+        // Resumed by the next wake()
+        if (park) {
+            m_scheduled = false;
+            return;
+        }
+
+        // An interruption requested during the invocation has found no timer to expire, don't sleep at all
+        if (m_loopInterruptRequested.load(std::memory_order_acquire)) {
+            deadline = QmlAVThreadPool::Clock::time_point{};
+        }
+
+        // The invocation has observed the state the pending wake() was about
+        m_wakePending = false;
+        m_timerDeadline = deadline;
+        m_timerWakeable = ctrl.isWait();
+    }
+
+    QmlAVThreadPool::instance().schedule(weak_from_this(), deadline);
+}
+
+void QmlAVWorkerThread::finish()
+{
+    std::scoped_lock lock(m_mutex);
+
+    m_running = false;
+    m_scheduled = false;
+
+    // Notify in lock context: the waiter may destroy this object as soon as wait() returns
     m_waitCond.notify_all();
 }
@@ -2,6 +2,9 @@
 #define QMLAVTHREAD_H
 
 #include <thread>
+#include <deque>
+#include <map>
+#include <vector>
 
 #include "qmlavwaitingqueue.h"
 #include "qmlavutils.h"
@@ -9,6 +12,8 @@
 class QmlAVLoopController
 {
 public:
+    using Clock = std::chrono::steady_clock;
+
     enum Operator {
         Break,
         Continue,
@@ -17,23 +22,34 @@ public:
 
     QmlAVLoopController(int64_t sleep = 0) : QmlAVLoopController(Continue, sleep) { }
     QmlAVLoopController(Operator ctrl, int64_t sleep = 0)
+        : m_ctrl(ctrl)
+        , m_wait(false)
     {
-        m_ctrl = ctrl;
-        m_sleep = std::max<int64_t>(0, sleep);
+        if (sleep > 0) {
+            m_deadline = Clock::now() + std::chrono::microseconds(sleep);
+        }
+    }
+
+    // The loop blocks until QmlAVWorkerThread::wake() or the deadline (if any), whichever comes first.
+    // Unlike the sleep above, a pending wake() is not lost and ends the wait immediately.
+    static QmlAVLoopController waitUntil(Operator ctrl, Clock::time_point deadline = {}) {
+        QmlAVLoopController c(ctrl);
+        c.m_wait = true;
+        c.m_deadline = deadline;
+        return c;
     }
 
     bool isBreak() const { return m_ctrl == Break; }
     bool isContinue() const { return m_ctrl == Continue; }
     bool isRetry() const { return m_ctrl == Retry; }
-    void sleep() const {
-        if (m_sleep > 0) {
-            std::this_thread::sleep_for(std::chrono::microseconds(m_sleep));
-        }
-    }
+    bool isWait() const { return m_wait; }
+    bool hasDeadline() const { return m_deadline != Clock::time_point{}; }
+    Clock::time_point deadline() const { return m_deadline; }
 
 private:
     Operator m_ctrl;
-    int64_t m_sleep;
+    bool m_wait;
+    Clock::time_point m_deadline;
 };
 
 class QmlAVAbstractWorker
@@ -45,6 +61,8 @@ public:
     virtual QmlAVLoopController invoke() = 0;
     virtual void *results() { return nullptr; }
     virtual void requestInterrupt() { }
+    // Pooled workers are parked while idle instead of being rescheduled
+    virtual bool isIdle() const { return false; }
 };
 
 template<typename Callable, typename Result = QmlAVUtils::InvokeResult<Callable>>
@@ -142,27 +160,42 @@ class QmlAVWorker<Callable, std::shared_ptr<ArgsQueue>> : public QmlAVWorkerInvo
 {
     using __Super = QmlAVWorkerInvokeImpl<Callable>;
 
-    static_assert(std::is_same_v<ArgsQueue, QmlAVWaitingQueue<typename __Super::ArgsTuple>>,
-                  "This implementation is only for \"std::shared_ptr<QmlAVWaitingQueue<InvokeArgsTuple<Callable>>>\" type.");
+    static_assert(std::is_same_v<typename ArgsQueue::ValueType, typename __Super::ArgsTuple>,
+                  "This implementation is only for \"std::shared_ptr<QmlAVWaitingQueue<InvokeArgsTuple<Callable>, Storage>>\" type.");
 
 public:
     QmlAVWorker(Callable callable, const std::shared_ptr<ArgsQueue> &argsQueue)
         : __Super(std::forward<Callable>(callable))
-        , m_argsQueue(argsQueue) { }
+        , m_argsQueue(argsQueue)
+        , m_interruptRequested(false) { }
 
+    // Processes the arguments queued so far in one batch, the ones enqueued meanwhile wait for the next invocation.
+    // NOTE: The batch is cut short as soon as the callable asks to wait, sleep or break.
     virtual QmlAVLoopController invoke() override final {
         typename __Super::ArgsTuple args;
 
-        if constexpr (__Super::isLoopCtrlResult()) {
-            if (m_argsQueue->head(args)) {
+        for (int batch = std::max(m_argsQueue->length(), 1); batch > 0; --batch) {
+            if (m_interruptRequested.load(std::memory_order_acquire)) {
+                break;
+            }
+
+            if constexpr (__Super::isLoopCtrlResult()) {
+                if (!m_argsQueue->head(args)) {
+                    break;
+                }
+
                 auto ctrl =  this->invokeImpl(args);
                 if (!ctrl.isRetry()) {
                     m_argsQueue->dequeue();
                 }
-                return ctrl;
-            }
-        } else {
-            if (m_argsQueue->dequeue(args)) {
+                if (ctrl.isBreak() || ctrl.isWait() || ctrl.hasDeadline()) {
+                    return ctrl;
+                }
+            } else {
+                if (!m_argsQueue->dequeue(args)) {
+                    break;
+                }
+
                 this->invokeImpl(args);
             }
         }
@@ -171,28 +204,104 @@ public:
     }
 
     virtual void requestInterrupt() override final {
+        m_interruptRequested.store(true, std::memory_order_release);
+
         if (m_argsQueue) {
             m_argsQueue->setConsumerLimit(0);
         }
 
         __Super::requestInterrupt();
     }
+    virtual bool isIdle() const override final {
+        return m_argsQueue->isEmpty();
+    }
 
 private:
     std::shared_ptr<ArgsQueue> m_argsQueue;
+    std::atomic<bool> m_interruptRequested;
 };
 
-class QmlAVWorkerThread
+class QmlAVWorkerThread;
+
+// Process-wide work-stealing executor with a bounded number of threads (one per core).
+// A worker rescheduled from a pool thread stays in that thread's local queue (cache affinity),
+// and idle threads steal from the busy ones, so the streams migrate between cores on demand.
+// Ordering is preserved by QmlAVWorkerThread itself: it is never queued more than once.
+// NOTE: Pooled workers must not block in invoke(), otherwise they starve the other workers.
+class QmlAVThreadPool
 {
+    using WorkerRef = std::weak_ptr<QmlAVWorkerThread>;
+
 public:
-    QmlAVWorkerThread(std::unique_ptr<QmlAVAbstractWorker> worker)
-        : m_running(false)
+    using Clock = QmlAVLoopController::Clock;
+
+    static QmlAVThreadPool &instance();
+
+    size_t size() const { return m_threads.size(); }
+    void schedule(WorkerRef thread, Clock::time_point deadline = {});
+    // Moves the thread scheduled at the deadline to the run queue right now
+    void expire(WorkerRef thread, Clock::time_point deadline);
+
+protected:
+    QmlAVThreadPool(size_t size);
+    ~QmlAVThreadPool();
+
+    void run(size_t index);
+    std::shared_ptr<QmlAVWorkerThread> next(size_t index);
+    bool hasWork() const;
+    void expireTimers(size_t index);
+    void notifyIdle();
+
+private:
+    struct LocalQueue {
+        mutable std::mutex mutex;
+        std::deque<WorkerRef> queue; // Owner pops from the front, thieves from the back
+    };
+
+    // NOTE: The pool does not own the workers, it only pins the one being stepped
+    std::vector<std::unique_ptr<LocalQueue>> m_localQueues;
+
+    // Everything below is guarded by m_mutex
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    std::deque<WorkerRef> m_injectionQueue; // Scheduled from outside of the pool
+    std::multimap<Clock::time_point, WorkerRef> m_timers;
+
+    std::atomic<bool> m_stopped;
+    std::atomic<int> m_idleCount;
+    std::atomic<Clock::rep> m_nextDeadline; // Lock-free check for expired timers
+
+    std::vector<std::thread> m_threads;
+};
+
+class QmlAVWorkerThread : public std::enable_shared_from_this<QmlAVWorkerThread>
+{
+public:
+    enum Policy {
+        Dedicated, // Own OS thread running the whole loop
+        Pooled     // Each invoke() is scheduled on the QmlAVThreadPool
+    };
+
+    QmlAVWorkerThread(std::unique_ptr<QmlAVAbstractWorker> worker, Policy policy = Dedicated)
+        : m_policy(policy)
+        , m_running(false)
+        , m_scheduled(false)
+        , m_wakePending(false)
+        , m_timerWakeable(false)
         , m_loopInterruptRequested(false)
+        , m_controllers(0)
         , m_worker(std::move(worker)) { }
 
+    Policy policy() const { return m_policy; }
+
     void start() {
         if (setRunning(true)) {
-            std::thread(&QmlAVWorkerThread::run, this).detach();
+            if (m_policy == Pooled) {
+                wake();
+            } else {
+                std::thread(&QmlAVWorkerThread::run, this).detach();
+            }
         }
     }
     void wait() {
@@ -208,6 +317,8 @@ public:
         return m_running;
     }
     void requestInterrupt();
+    // Ends the QmlAVLoopController::waitUntil() wait, or the next one if the loop is not waiting yet
+    void wake();
 
     void *results() {
         if (m_worker) {
@@ -219,6 +330,9 @@ public:
 
 protected:
     void run();
+    void step();
+    void sleep(const QmlAVLoopController &ctrl);
+    void finish();
     bool setRunning(bool running) {
         std::scoped_lock lock(m_mutex);
 
@@ -230,13 +344,25 @@ protected:
     }
 
 private:
+    const Policy m_policy;
+
     mutable std::mutex m_mutex;
     std::condition_variable m_waitCond;
+    std::condition_variable m_wakeCond;
 
     bool m_running;
+    bool m_scheduled;   // Pooled only: queued or being invoked by the pool
+    bool m_wakePending; // wake() was called, but not observed by the loop yet
+    QmlAVThreadPool::Clock::time_point m_timerDeadline; // Pooled only: pending pool timer
+    bool m_timerWakeable; // Pooled only: the timer belongs to waitUntil()
     std::atomic<bool> m_loopInterruptRequested;
+    // NOTE: Not the use_count(), the pool and the producers hold the temporary references as well
+    std::atomic<int> m_controllers;
 
     std::unique_ptr<QmlAVAbstractWorker> m_worker;
+
+    friend class QmlAVThreadPool;
+    template<typename> friend class QmlAVThreadLiveController;
 };
 
 // NOTE: For use from a single thread only!
@@ -245,18 +371,32 @@ class QmlAVThreadLiveController
 {
 public:
     QmlAVThreadLiveController() : m_thread(nullptr) { }
+    QmlAVThreadLiveController(const QmlAVThreadLiveController &other) : m_thread(other.m_thread) {
+        retain();
+    }
+    QmlAVThreadLiveController(QmlAVThreadLiveController &&other) noexcept : m_thread(std::move(other.m_thread)) { }
     virtual ~QmlAVThreadLiveController() {
         logDebug() << "~QmlAVThreadLiveController()";
 
-        // In multithreaded environment, the value returned by use_count() is approximate
-        // (typical implementations use a std::memory_order_relaxed load).
-        if (m_thread.use_count() == 1) {
-            if (m_thread->isRunning()) {
-                logWarning() << "Attempting to destroy an object of a running thread!";
-            }
+        release();
+    }
 
-            requestInterrupt(true);
+    QmlAVThreadLiveController &operator=(const QmlAVThreadLiveController &other) {
+        if (this != &other) {
+            release();
+            m_thread = other.m_thread;
+            retain();
         }
+
+        return *this;
+    }
+    QmlAVThreadLiveController &operator=(QmlAVThreadLiveController &&other) noexcept {
+        if (this != &other) {
+            release();
+            m_thread = std::move(other.m_thread);
+        }
+
+        return *this;
     }
 
     void requestInterrupt(bool wait = false) {
@@ -282,6 +422,11 @@ public:
             m_thread->wait();
         }
     }
+    void wake() {
+        if (m_thread) {
+            m_thread->wake();
+        }
+    }
 
     template<typename T = Result, typename = QmlAVUtils::EnableForNonVoid<T>>
     Result result() const {
@@ -321,22 +466,42 @@ protected:
     QmlAVThreadLiveController(std::shared_ptr<QmlAVWorkerThread> thread) : m_thread(thread) {
         logDebug() << QString("QmlAVThreadLiveController(thread=0x%1)").arg(QString().number(reinterpret_cast<uintptr_t>(m_thread.get()), 16));
 
+        retain();
+
         if (m_thread) {
             m_thread->start();
         }
     }
 
+    void retain() {
+        if (m_thread) {
+            m_thread->m_controllers.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // The last controller interrupts the thread and waits for it to finish
+    void release() {
+        if (!m_thread || m_thread->m_controllers.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+
+        if (m_thread->isRunning()) {
+            logWarning() << "Attempting to destroy an object of a running thread!";
+        }
+
+        requestInterrupt(true);
+    }
+
 private:
     std::shared_ptr<QmlAVWorkerThread> m_thread;
 
     friend class QmlAVThread;
-    template<typename> friend class QmlAVThreadTask;
+    template<typename, typename> friend class QmlAVThreadTask;
 };
 
-template<typename Callable>
+template<typename Callable, typename Storage = QmlAVLockedStorage>
 class QmlAVThreadTask
 {
-    using ArgsQueue = QmlAVWaitingQueue<QmlAVUtils::InvokeArgsTuple<Callable>>;
+    using ArgsQueue = QmlAVWaitingQueue<QmlAVUtils::InvokeArgsTuple<Callable>, Storage>;
 
 public:
     QmlAVThreadTask(Callable &&callable)
@@ -351,12 +516,22 @@ public:
         m_argsQueue->enqueue(std::forward_as_tuple(args...));
     }
 
-    auto getLiveController() {
+    auto getLiveController(QmlAVWorkerThread::Policy policy = QmlAVWorkerThread::Dedicated) {
         assert(!m_started);
         m_started = true;
 
         auto worker = std::make_unique<QmlAVWorker<Callable, std::shared_ptr<ArgsQueue>>>(std::move(m_callable), m_argsQueue);
-        auto thread = std::make_shared<QmlAVWorkerThread>(std::move(worker));
+        auto thread = std::make_shared<QmlAVWorkerThread>(std::move(worker), policy);
+
+        if (policy == QmlAVWorkerThread::Pooled) {
+            // The pooled worker must not block on the empty queue, it is resumed by the producer instead
+            m_argsQueue->setConsumerLimit(0);
+            m_argsQueue->setNotifier([t = std::weak_ptr<QmlAVWorkerThread>(thread)] {
+                if (auto thread = t.lock()) {
+                    thread->wake();
+                }
+            });
+        }
 
         using Result = QmlAVUtils::InvokeResult<Callable>;
         return QmlAVThreadLiveController<Result>(thread);
@@ -375,16 +550,32 @@ class QmlAVThread
 public:
     template<typename Callable, typename ...Args>
     static auto run(Callable &&callable, Args &&...args) {
-        auto worker = std::make_unique<QmlAVWorker<Callable, Args...>>(std::forward<Callable>(callable), std::forward<Args>(args)...);
-        auto thread = std::make_shared<QmlAVWorkerThread>(std::move(worker));
-
-        using Result = QmlAVUtils::InvokeResult<Callable>;
-        return QmlAVThreadLiveController<Result>(thread);
+        return start(QmlAVWorkerThread::Dedicated, std::forward<Callable>(callable), std::forward<Args>(args)...);
     }
     template<typename Callable>
     static auto loop(Callable &&callable) {
         return run(std::forward<Callable>(callable));
     }
+
+    // Same as above, but on the process-wide QmlAVThreadPool
+    template<typename Callable, typename ...Args>
+    static auto runPooled(Callable &&callable, Args &&...args) {
+        return start(QmlAVWorkerThread::Pooled, std::forward<Callable>(callable), std::forward<Args>(args)...);
+    }
+    template<typename Callable>
+    static auto loopPooled(Callable &&callable) {
+        return runPooled(std::forward<Callable>(callable));
+    }
+
+protected:
+    template<typename Callable, typename ...Args>
+    static auto start(QmlAVWorkerThread::Policy policy, Callable &&callable, Args &&...args) {
+        auto worker = std::make_unique<QmlAVWorker<Callable, Args...>>(std::forward<Callable>(callable), std::forward<Args>(args)...);
+        auto thread = std::make_shared<QmlAVWorkerThread>(std::move(worker), policy);
+
+        using Result = QmlAVUtils::InvokeResult<Callable>;
+        return QmlAVThreadLiveController<Result>(thread);
+    }
 };
 
 #endif // QMLAVTHREAD_H
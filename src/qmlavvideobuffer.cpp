@@ -3,20 +3,17 @@
 
 extern "C" {
 #include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
 }
 
 QmlAVVideoBuffer::QmlAVVideoBuffer(const QmlAVVideoFrame &videoFrame, QAbstractVideoBuffer::HandleType type)
     : QAbstractPlanarVideoBuffer(type)
     , m_videoFrame(videoFrame)
     , m_mapMode(NotMapped)
-    , m_swsCtx(nullptr)
 {
 }
 
 QmlAVVideoBuffer::~QmlAVVideoBuffer()
 {
-    sws_freeContext(m_swsCtx);
 }
 
 int QmlAVVideoBuffer::map(QAbstractVideoBuffer::MapMode mode, int *numBytes, int bytesPerLine[], uchar *data[])
@@ -37,17 +34,17 @@ int QmlAVVideoBuffer::map(QAbstractVideoBuffer::MapMode mode, int *numBytes, int
     return i;
 }
 
-bool QmlAVVideoBuffer::planeSizes(int size[]) const
+bool QmlAVVideoBuffer::planeSizes(const QmlAVVideoFrame &videoFrame, int size[])
 {
 #if (LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 56, 100))
     ptrdiff_t lineSizes[QMLAV_NUM_DATA_POINTERS];
     size_t planeSizes[QMLAV_NUM_DATA_POINTERS];
 
     for (int i = 0; i < QMLAV_NUM_DATA_POINTERS; ++i) {
-        lineSizes[i] = m_videoFrame.avFrame()->linesize[i];
+        lineSizes[i] = videoFrame.avFrame()->linesize[i];
     }
 
-    if (av_image_fill_plane_sizes(planeSizes, m_videoFrame.pixelFormat(), m_videoFrame.avFrame()->height, lineSizes) >= 0) {
+    if (av_image_fill_plane_sizes(planeSizes, videoFrame.pixelFormat(), videoFrame.avFrame()->height, lineSizes) >= 0) {
         for (int i = 0; i < QMLAV_NUM_DATA_POINTERS; ++i) {
             size[i] = planeSizes[i];
         }
@@ -58,10 +55,10 @@ bool QmlAVVideoBuffer::planeSizes(int size[]) const
 #else
     // Calculating plane sizes from plane pointers
     uint8_t *data[QMLAV_NUM_DATA_POINTERS];
-    int dataSize = av_image_fill_pointers(data, m_videoFrame.pixelFormat(),
-                                          m_videoFrame.avFrame()->height,
+    int dataSize = av_image_fill_pointers(data, videoFrame.pixelFormat(),
+                                          videoFrame.avFrame()->height,
                                           0, // Initial value for data[0]
-                                          m_videoFrame.avFrame()->linesize);
+                                          videoFrame.avFrame()->linesize);
     if (dataSize > 0) {
         for (int i = 1;; ++i) {
             if (i < QMLAV_NUM_DATA_POINTERS && data[i]) {
@@ -79,30 +76,10 @@ bool QmlAVVideoBuffer::planeSizes(int size[]) const
     return false;
 }
 
+// NOTE: The scaling context is cached per decoder, a buffer lives for a single frame only
 AVFramePtr QmlAVVideoBuffer::swsScale(const QmlAVPixelFormat &dstFormat)
 {
-    AVFramePtr avFrameSws;
-    AVPixelFormat srcAVFormat = QmlAVPixelFormat(m_videoFrame.avFrame()->format); // Normalize
-
-    // TODO: Test different "flags" for performance improvement
-    m_swsCtx = sws_getCachedContext(m_swsCtx,
-                                    m_videoFrame.avFrame()->width, m_videoFrame.avFrame()->height,
-                                    srcAVFormat,
-                                    m_videoFrame.avFrame()->width, m_videoFrame.avFrame()->height,
-                                    dstFormat,
-                                    SWS_BILINEAR,
-                                    nullptr, nullptr, nullptr);
-
-    if (m_swsCtx) {
-        avFrameSws->width = m_videoFrame.avFrame()->width;
-        avFrameSws->height = m_videoFrame.avFrame()->height;
-        avFrameSws->format = dstFormat;
-        av_frame_get_buffer(avFrameSws, FFMPEG_ALIGNMENT);
-
-        sws_scale(m_swsCtx, m_videoFrame.avFrame()->data, m_videoFrame.avFrame()->linesize, 0, m_videoFrame.avFrame()->height, avFrameSws->data, avFrameSws->linesize);
-    }
-
-    return avFrameSws;
+    return m_videoFrame.scaler().scale(m_videoFrame.avFrame(), m_videoFrame.avFrame()->width, m_videoFrame.avFrame()->height, dstFormat);
 }
 
 QmlAVVideoBuffer_CPU::QmlAVVideoBuffer_CPU(const QmlAVVideoFrame &videoFrame)
@@ -120,12 +97,12 @@ QmlAVVideoBuffer::MapData QmlAVVideoBuffer_CPU::map(QAbstractVideoBuffer::MapMod
 
         if (srcFormat != dstFormat) {
             AVFramePtr avFrameSws = swsScale(dstFormat);
-            if (av_frame_copy_props(avFrameSws, m_videoFrame.avFrame()) == 0) {
+            if (avFrameSws) {
                 m_videoFrame.avFrame() = avFrameSws;
             }
         }
 
-        if (planeSizes(mapData.size)) {
+        if (planeSizes(m_videoFrame, mapData.size)) {
             for (int i = 0; i < QMLAV_NUM_DATA_POINTERS; ++i) {
                 mapData.bytesPerLine[i] = m_videoFrame.avFrame()->linesize[i];
                 mapData.data[i] = m_videoFrame.avFrame()->data[i];
@@ -155,10 +132,11 @@ QmlAVVideoBuffer_GPU::QmlAVVideoBuffer_GPU(const QmlAVVideoFrame &videoFrame, st
 QmlAVVideoBuffer::MapData QmlAVVideoBuffer_GPU::map(QAbstractVideoBuffer::MapMode mode)
 {
     int ret;
-    AVFramePtr avFrameSw;
-
-    if (mapMode() == QAbstractVideoBuffer::NotMapped) {
 
+    // NOTE: Software frames are only here for a GPU conversion, they are mapped as is
+    if (mapMode() == QAbstractVideoBuffer::NotMapped && m_videoFrame.isHWDecoded()) {
+        // Download into a recycled buffer, FFmpeg allocates a new one if the pool has failed
+        AVFramePtr avFrameSw = m_videoFrame.framePool().frame(m_videoFrame.width(), m_videoFrame.height(), m_videoFrame.swPixelFormat());
         avFrameSw->format = m_videoFrame.swPixelFormat(); // Important!
 
         ret = av_hwframe_transfer_data(avFrameSw, m_videoFrame.avFrame(), 0);
@@ -189,3 +167,80 @@ QmlAVPixelFormat QmlAVVideoBuffer_GPU::pixelFormat() const
 
     return m_videoFrame.swPixelFormat().nearestQtNative();
 }
+
+QmlAVVideoBuffer_Native::QmlAVVideoBuffer_Native()
+    : QAbstractPlanarVideoBuffer(QAbstractVideoBuffer::NoHandle)
+    , m_numBytes(0)
+    , m_mapMode(NotMapped)
+{
+}
+
+void QmlAVVideoBuffer_Native::bind(const std::shared_ptr<const QmlAVVideoFrame> &videoFrame)
+{
+    m_videoFrame = videoFrame;
+    m_mapData = {};
+    m_numBytes = 0;
+
+    if (QmlAVVideoBuffer::planeSizes(*m_videoFrame, m_mapData.size)) {
+        for (int i = 0; i < QMLAV_NUM_DATA_POINTERS; ++i) {
+            m_mapData.bytesPerLine[i] = m_videoFrame->avFrame()->linesize[i];
+            m_mapData.data[i] = m_videoFrame->avFrame()->data[i];
+            m_numBytes += m_mapData.size[i];
+        }
+    }
+}
+
+int QmlAVVideoBuffer_Native::map(QAbstractVideoBuffer::MapMode mode, int *numBytes, int bytesPerLine[], uchar *data[])
+{
+    if (mode == QAbstractVideoBuffer::NotMapped) {
+        return 0;
+    }
+
+    *numBytes = m_numBytes;
+    for (int i = 0; i < QMLAV_NUM_DATA_POINTERS; ++i) {
+        bytesPerLine[i] = m_mapData.bytesPerLine[i];
+        data[i] = m_mapData.data[i];
+    }
+
+    m_mapMode = mode;
+
+    return QMLAV_NUM_DATA_POINTERS;
+}
+
+void QmlAVVideoBuffer_Native::release()
+{
+    // NOTE: The frame keeps the decoder and so the pool alive, so it must be the last to go.
+    // The pool may delete this buffer in the meantime, the members must not be touched after recycle().
+    auto videoFrame = std::move(m_videoFrame);
+    m_mapMode = NotMapped;
+
+    videoFrame->bufferPool().recycle(this);
+}
+
+QmlAVVideoBufferPool::~QmlAVVideoBufferPool()
+{
+    for (auto buffer : m_buffers) {
+        delete buffer;
+    }
+}
+
+QmlAVVideoBuffer_Native *QmlAVVideoBufferPool::acquire()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+
+        if (!m_buffers.empty()) {
+            auto buffer = m_buffers.back();
+            m_buffers.pop_back();
+            return buffer;
+        }
+    }
+
+    return new QmlAVVideoBuffer_Native();
+}
+
+void QmlAVVideoBufferPool::recycle(QmlAVVideoBuffer_Native *buffer)
+{
+    std::scoped_lock lock(m_mutex);
+    m_buffers.push_back(buffer);
+}
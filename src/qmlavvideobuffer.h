@@ -3,11 +3,12 @@
 
 #include <QAbstractPlanarVideoBuffer>
 
+#include <mutex>
+#include <vector>
+
 #include "qmlavframe.h"
 #include "qmlavhwoutput.h"
 
-struct SwsContext;
-
 class QmlAVVideoBuffer : public QAbstractPlanarVideoBuffer
 {
 public:
@@ -30,9 +31,10 @@ public:
 
     virtual QmlAVPixelFormat pixelFormat() const = 0;
 
+    static bool planeSizes(const QmlAVVideoFrame &videoFrame, int size[]);
+
 protected:
     void setMapMode(QAbstractVideoBuffer::MapMode mapMode) { m_mapMode = mapMode; }
-    bool planeSizes(int size[]) const;
     AVFramePtr swsScale(const QmlAVPixelFormat &dstFormat);
 
 protected:
@@ -40,7 +42,6 @@ protected:
 
 private:
     MapMode m_mapMode;
-    SwsContext *m_swsCtx;
 };
 
 class QmlAVVideoBuffer_CPU : public QmlAVVideoBuffer
@@ -67,4 +68,44 @@ private:
     std::shared_ptr<QmlAVHWOutput> m_hwOutput;
 };
 
+// Qt-native software frames are presented as is: the buffer only refers to the decoded frame
+// with its plane layout computed once and is recycled by QmlAVVideoBufferPool instead of being deleted.
+class QmlAVVideoBuffer_Native final : public QAbstractPlanarVideoBuffer
+{
+public:
+    QmlAVVideoBuffer_Native();
+
+    void bind(const std::shared_ptr<const QmlAVVideoFrame> &videoFrame);
+
+    QAbstractVideoBuffer::MapMode mapMode() const override { return m_mapMode; }
+    void unmap() override { m_mapMode = QAbstractVideoBuffer::NotMapped; }
+    int map(QAbstractVideoBuffer::MapMode mapMode, int *numBytes, int bytesPerLine[], uchar *data[]) override;
+    // NOTE: Called by QVideoFrame instead of the destructor
+    void release() override;
+
+private:
+    std::shared_ptr<const QmlAVVideoFrame> m_videoFrame;
+    QmlAVVideoBuffer::MapData m_mapData;
+    int m_numBytes;
+    MapMode m_mapMode;
+};
+
+// NOTE: Thread safe. The buffers are acquired by the GUI thread and released by the render thread.
+class QmlAVVideoBufferPool
+{
+public:
+    QmlAVVideoBufferPool() { }
+    ~QmlAVVideoBufferPool();
+
+    QmlAVVideoBufferPool(const QmlAVVideoBufferPool &other) = delete;
+    QmlAVVideoBufferPool &operator=(const QmlAVVideoBufferPool &other) = delete;
+
+    QmlAVVideoBuffer_Native *acquire();
+    void recycle(QmlAVVideoBuffer_Native *buffer);
+
+private:
+    std::mutex m_mutex;
+    std::vector<QmlAVVideoBuffer_Native *> m_buffers; // Idle ones
+};
+
 #endif // QMLAVVIDEOBUFFER_H
@@ -4,11 +4,49 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <array>
+#include <tuple>
+#include <type_traits>
 
-template<typename T>
+// Storage of QmlAVWaitingQueue: std::queue guarded by the mutex (default)
+struct QmlAVLockedStorage { };
+// Storage of QmlAVWaitingQueue: bounded lock-free ring for a single producer and a single consumer
+template<size_t Capacity>
+struct QmlAVLockFreeStorage { };
+
+// Cost of the queued values for the producer weight limit, e.g. packet bytes and duration (0 = Unlim)
+struct QmlAVQueueWeight {
+    int64_t bytes = 0;
+    int64_t duration = 0;
+
+    // NOTE: An empty queue accepts any value, so a single value can't exceed the limit forever
+    bool isBelow(const QmlAVQueueWeight &limit) const {
+        return (limit.bytes <= 0 || bytes < limit.bytes) && (limit.duration <= 0 || duration < limit.duration);
+    }
+
+    QmlAVQueueWeight &operator+=(const QmlAVQueueWeight &other) {
+        bytes += other.bytes;
+        duration += other.duration;
+        return *this;
+    }
+    QmlAVQueueWeight &operator-=(const QmlAVQueueWeight &other) {
+        bytes -= other.bytes;
+        duration -= other.duration;
+        return *this;
+    }
+};
+
+template<typename T, typename Storage = QmlAVLockedStorage>
 class QmlAVWaitingQueue
 {
+    static_assert(std::is_same_v<Storage, QmlAVLockedStorage>, "Unknown QmlAVWaitingQueue storage.");
+
 public:
+    using ValueType = T;
+
     QmlAVWaitingQueue()
         : m_producerLimit(0) // Unlim
         , m_consumerLimit(1) { }
@@ -31,15 +69,25 @@ public:
 
             m_producerCond.wait(lock, [&] {
                 // Executes in lock context
-                return m_producerLimit == 0 || m_queue.size() < m_producerLimit;
+                return (m_producerLimit == 0 || m_queue.size() < m_producerLimit) &&
+                       (m_queue.empty() || m_weight.isBelow(m_weightLimit));
             });
 
-            m_queue.push(std::forward<URef>(value));
+            m_queue.emplace(std::forward<URef>(value), QmlAVQueueWeight());
+            if (m_weigher) {
+                // Weigh the stored value, the argument may be a tuple of references
+                m_queue.back().second = m_weigher(m_queue.back().first);
+                m_weight += m_queue.back().second;
+            }
         }
 
         // NOTE: Designed for one queue = one consumer
         // More consumers would still work but underperform (notify_one fairness)
         m_consumerCond.notify_one();
+
+        if (m_notifier) {
+            m_notifier();
+        }
     }
     bool head(T &value) {
         std::unique_lock<std::mutex> lock(m_mutex);
@@ -53,7 +101,7 @@ public:
             return false;
         }
 
-        value = m_queue.front();
+        value = m_queue.front().first;
 
         return true;
     }
@@ -70,7 +118,8 @@ public:
                 return false;
             }
 
-            value = std::move(m_queue.front());
+            value = std::move(m_queue.front().first);
+            m_weight -= m_queue.front().second;
             m_queue.pop();
         }
         m_producerCond.notify_all();
@@ -81,6 +130,7 @@ public:
         {
             std::scoped_lock lock(m_mutex);
             if (!m_queue.empty()) {
+                m_weight -= m_queue.front().second;
                 m_queue.pop();
             }
         }
@@ -110,6 +160,24 @@ public:
         }
         m_consumerCond.notify_all();
     }
+    void setWeightLimit(QmlAVQueueWeight limit) {
+        {
+            std::scoped_lock lock(m_mutex);
+            m_weightLimit = limit;
+        }
+        m_producerCond.notify_all();
+    }
+
+    // Invoked outside the lock context after each enqueue(), e.g. to resume a non-blocking consumer.
+    // NOTE: Not thread safe! Must be set before the queue is shared with a producer.
+    void setNotifier(std::function<void()> notifier) {
+        m_notifier = std::move(notifier);
+    }
+    // Invoked once per enqueue() in the producer context, so it may keep the producer state.
+    // NOTE: Not thread safe! Must be set before the queue is shared with a producer.
+    void setWeigher(std::function<QmlAVQueueWeight(const T &)> weigher) {
+        m_weigher = std::move(weigher);
+    }
 
     // NOTE: Be careful! Potential API race.
     bool isEmpty() const {
@@ -120,14 +188,248 @@ public:
         std::scoped_lock lock(m_mutex);
         return m_queue.size();
     }
+    QmlAVQueueWeight weight() const {
+        std::scoped_lock lock(m_mutex);
+        return m_weight;
+    }
 
 private:
     mutable std::mutex m_mutex;
     std::condition_variable m_producerCond;
     std::condition_variable m_consumerCond;
 
-    std::queue<T> m_queue;
+    std::queue<std::pair<T, QmlAVQueueWeight>> m_queue;
     size_t m_producerLimit, m_consumerLimit;
+    QmlAVQueueWeight m_weight, m_weightLimit;
+
+    std::function<void()> m_notifier;
+    std::function<QmlAVQueueWeight(const T &)> m_weigher;
+};
+
+// The same semantics as above, but the queue is lock-free as long as neither side has to wait.
+// The producer limit is clamped to the ring capacity (0 = Capacity).
+// The weight limit is checked against the weight the producer sees, which may lag behind the consumer.
+// NOTE: Strictly one producer and one consumer thread at a time!
+template<typename T, size_t Capacity>
+class QmlAVWaitingQueue<T, QmlAVLockFreeStorage<Capacity>>
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "QmlAVLockFreeStorage capacity must be a power of two.");
+
+public:
+    using ValueType = T;
+
+    QmlAVWaitingQueue()
+        : m_head(0)
+        , m_tail(0)
+        , m_producerLimit(0) // Capacity
+        , m_consumerLimit(1)
+        , m_bytes(0)
+        , m_duration(0)
+        , m_bytesLimit(0) // Unlim
+        , m_durationLimit(0) // Unlim
+        , m_producerWaiters(0)
+        , m_consumerWaiters(0) { }
+    virtual ~QmlAVWaitingQueue()
+    {
+        setProducerLimit(0);
+        setConsumerLimit(0);
+    }
+
+    QmlAVWaitingQueue(const QmlAVWaitingQueue &other) = delete;
+    QmlAVWaitingQueue(QmlAVWaitingQueue &&other) = delete;
+
+    QmlAVWaitingQueue &operator=(const QmlAVWaitingQueue &other) = delete;
+    QmlAVWaitingQueue &operator=(QmlAVWaitingQueue &&other) = delete;
+
+    template<typename URef>
+    void enqueue(URef &&value) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (!canProduce(tail, std::memory_order_acquire)) {
+            wait(m_producerCond, m_producerWaiters, [&] { return canProduce(tail, std::memory_order_seq_cst); });
+        }
+
+        T &slot = m_ring[tail & (Capacity - 1)];
+        slot = std::forward<URef>(value);
+
+        QmlAVQueueWeight &weight = m_weights[tail & (Capacity - 1)];
+        weight = m_weigher ? m_weigher(slot) : QmlAVQueueWeight();
+        m_bytes.fetch_add(weight.bytes, std::memory_order_relaxed);
+        m_duration.fetch_add(weight.duration, std::memory_order_relaxed);
+        m_tail.store(tail + 1, std::memory_order_seq_cst);
+        notify(m_consumerCond, m_consumerWaiters);
+
+        if (m_notifier) {
+            m_notifier();
+        }
+    }
+    bool head(T &value) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (!waitForConsume(head)) {
+            return false;
+        }
+
+        value = m_ring[head & (Capacity - 1)];
+
+        return true;
+    }
+    bool dequeue(T &value) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (!waitForConsume(head)) {
+            return false;
+        }
+
+        value = std::move(m_ring[head & (Capacity - 1)]);
+        release(head);
+
+        return true;
+    }
+    void dequeue() {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head != m_tail.load(std::memory_order_acquire)) {
+            clear(m_ring[head & (Capacity - 1)]); // Don't hold the resources until the slot is reused
+            release(head);
+        }
+    }
+
+    void waitForEmpty() {
+        if (!isEmpty()) {
+            wait(m_producerCond, m_producerWaiters, [&] {
+                return m_head.load(std::memory_order_seq_cst) == m_tail.load(std::memory_order_seq_cst);
+            });
+        }
+    }
+
+    void setProducerLimit(size_t limit) {
+        m_producerLimit.store(limit, std::memory_order_seq_cst);
+        notify(m_producerCond, m_producerWaiters);
+    }
+    void setConsumerLimit(size_t limit) {
+        m_consumerLimit.store(limit, std::memory_order_seq_cst);
+        notify(m_consumerCond, m_consumerWaiters);
+    }
+    void setWeightLimit(QmlAVQueueWeight limit) {
+        m_bytesLimit.store(limit.bytes, std::memory_order_seq_cst);
+        m_durationLimit.store(limit.duration, std::memory_order_seq_cst);
+        notify(m_producerCond, m_producerWaiters);
+    }
+
+    // Invoked after each enqueue(), e.g. to resume a non-blocking consumer.
+    // NOTE: Not thread safe! Must be set before the queue is shared with a producer.
+    void setNotifier(std::function<void()> notifier) {
+        m_notifier = std::move(notifier);
+    }
+    // Invoked once per enqueue() in the producer context, so it may keep the producer state.
+    // NOTE: Not thread safe! Must be set before the queue is shared with a producer.
+    void setWeigher(std::function<QmlAVQueueWeight(const T &)> weigher) {
+        m_weigher = std::move(weigher);
+    }
+
+    // NOTE: Be careful! Potential API race.
+    bool isEmpty() const {
+        return length() == 0;
+    }
+    int length() const {
+        // Load the head first, so that the difference never underflows
+        const size_t head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+    QmlAVQueueWeight weight() const {
+        return {m_bytes.load(std::memory_order_relaxed), m_duration.load(std::memory_order_relaxed)};
+    }
+
+private:
+    template<typename U, typename = void>
+    struct HasUnref : std::false_type { };
+    template<typename U>
+    struct HasUnref<U, std::void_t<decltype(std::declval<U &>().unref())>> : std::true_type { };
+    template<typename U>
+    struct IsTuple : std::false_type { };
+    template<typename ...Types>
+    struct IsTuple<std::tuple<Types...>> : std::true_type { };
+
+    // Releases the slot in place, e.g. AVPacketPtr() would allocate a new packet on each dequeue
+    template<typename U>
+    static void clear(U &value) {
+        if constexpr (IsTuple<U>::value) {
+            std::apply([](auto &...values) { (clear(values), ...); }, value);
+        } else if constexpr (HasUnref<U>::value) {
+            value.unref();
+        } else {
+            value = U();
+        }
+    }
+
+    bool canProduce(size_t tail, std::memory_order order) const {
+        size_t limit = m_producerLimit.load(order);
+        if (limit == 0 || limit > Capacity) {
+            limit = Capacity;
+        }
+
+        const size_t length = tail - m_head.load(order);
+        if (length >= limit) {
+            return false;
+        }
+
+        QmlAVQueueWeight weightLimit = {m_bytesLimit.load(order), m_durationLimit.load(order)};
+        return length == 0 || QmlAVQueueWeight{m_bytes.load(order), m_duration.load(order)}.isBelow(weightLimit);
+    }
+    bool canConsume(size_t head, std::memory_order order) const {
+        return m_tail.load(order) - head >= m_consumerLimit.load(order);
+    }
+    bool waitForConsume(size_t head) {
+        if (!canConsume(head, std::memory_order_acquire)) {
+            wait(m_consumerCond, m_consumerWaiters, [&] { return canConsume(head, std::memory_order_seq_cst); });
+        }
+
+        return m_tail.load(std::memory_order_acquire) != head;
+    }
+    void release(size_t head) {
+        const QmlAVQueueWeight &weight = m_weights[head & (Capacity - 1)];
+        m_bytes.fetch_sub(weight.bytes, std::memory_order_relaxed);
+        m_duration.fetch_sub(weight.duration, std::memory_order_relaxed);
+
+        m_head.store(head + 1, std::memory_order_seq_cst);
+        notify(m_producerCond, m_producerWaiters);
+    }
+
+    // Slow path. The waiter registers itself before checking the condition and the other side
+    // checks for waiters after publishing the index (both seq_cst), so a wakeup can't be lost.
+    template<typename Predicate>
+    void wait(std::condition_variable &cond, std::atomic<int> &waiters, Predicate isReady) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        cond.wait(lock, isReady);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+    void notify(std::condition_variable &cond, const std::atomic<int> &waiters) {
+        if (waiters.load(std::memory_order_seq_cst) > 0) {
+            {
+                // The waiter is either blocked already or will see the new state
+                std::scoped_lock lock(m_mutex);
+            }
+            cond.notify_all();
+        }
+    }
+
+    std::array<T, Capacity> m_ring;
+    std::array<QmlAVQueueWeight, Capacity> m_weights;
+
+    // NOTE: Separate cache lines, so the producer and the consumer don't invalidate each other
+    alignas(64) std::atomic<size_t> m_head; // Written by the consumer only
+    alignas(64) std::atomic<size_t> m_tail; // Written by the producer only
+    std::atomic<size_t> m_producerLimit, m_consumerLimit;
+    std::atomic<int64_t> m_bytes, m_duration;
+    std::atomic<int64_t> m_bytesLimit, m_durationLimit;
+
+    std::mutex m_mutex;
+    std::condition_variable m_producerCond;
+    std::condition_variable m_consumerCond;
+    std::atomic<int> m_producerWaiters, m_consumerWaiters;
+
+    std::function<void()> m_notifier;
+    std::function<QmlAVQueueWeight(const T &)> m_weigher;
 };
 
 #endif // QMLAVWAITINGQUEUE_H
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include "./../qmlavdemuxer.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#define FRAMES_COUNT 12
+
+// A short clip with B-frames, so the decoder holds the last frames back until it is drained
+static void writeClip(const QString &fileName)
+{
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    ASSERT_NE(codec, nullptr);
+
+    AVFormatContext *avFormatCtx = nullptr;
+    ASSERT_GE(avformat_alloc_output_context2(&avFormatCtx, nullptr, "nut", fileName.toUtf8()), 0);
+
+    AVCodecContext *avCodecCtx = avcodec_alloc_context3(codec);
+    avCodecCtx->width = 64;
+    avCodecCtx->height = 64;
+    avCodecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    avCodecCtx->time_base = {1, 25};
+    avCodecCtx->framerate = {25, 1};
+    avCodecCtx->gop_size = FRAMES_COUNT;
+    avCodecCtx->max_b_frames = 2;
+    if (avFormatCtx->oformat->flags & AVFMT_GLOBALHEADER) {
+        avCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    ASSERT_GE(avcodec_open2(avCodecCtx, codec, nullptr), 0);
+
+    AVStream *avStream = avformat_new_stream(avFormatCtx, nullptr);
+    avcodec_parameters_from_context(avStream->codecpar, avCodecCtx);
+    avStream->time_base = avCodecCtx->time_base;
+
+    ASSERT_GE(avio_open(&avFormatCtx->pb, fileName.toUtf8(), AVIO_FLAG_WRITE), 0);
+    ASSERT_GE(avformat_write_header(avFormatCtx, nullptr), 0);
+
+    auto encode = [&](const AVFrame *avFrame) {
+        avcodec_send_frame(avCodecCtx, avFrame);
+
+        AVPacketPtr avPacket;
+        while (avcodec_receive_packet(avCodecCtx, avPacket) == 0) {
+            av_packet_rescale_ts(avPacket, avCodecCtx->time_base, avStream->time_base);
+            avPacket->stream_index = avStream->index;
+            av_interleaved_write_frame(avFormatCtx, avPacket);
+        }
+    };
+
+    for (int i = 0; i < FRAMES_COUNT; ++i) {
+        AVFramePtr avFrame;
+        avFrame->width = avCodecCtx->width;
+        avFrame->height = avCodecCtx->height;
+        avFrame->format = avCodecCtx->pix_fmt;
+        ASSERT_GE(av_frame_get_buffer(avFrame, 0), 0);
+
+        memset(avFrame->data[0], 16 + i * 16, avFrame->linesize[0] * avFrame->height);
+        memset(avFrame->data[1], 128, avFrame->linesize[1] * avFrame->height / 2);
+        memset(avFrame->data[2], 128, avFrame->linesize[2] * avFrame->height / 2);
+        avFrame->pts = i;
+
+        encode(avFrame);
+    }
+    encode(nullptr); // Flush the encoder
+
+    av_write_trailer(avFormatCtx);
+    avio_closep(&avFormatCtx->pb);
+    avformat_free_context(avFormatCtx);
+    avcodec_free_context(&avCodecCtx);
+}
+
+TEST(QmlAVDemuxer, EndOfMedia_LastFramePresented)
+{
+    char arg0[] = "tests";
+    char *argv[] = {arg0, nullptr};
+    int argc = 1;
+    QCoreApplication app(argc, argv);
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString fileName = dir.filePath("clip.nut");
+    ASSERT_NO_FATAL_FAILURE(writeClip(fileName));
+
+    QmlAVDemuxer demuxer;
+    QEventLoop loop;
+
+    std::vector<int64_t> presented; // us
+    bool endOfMedia = false;
+    bool presentedAfterEnd = false;
+
+    // NOTE: The local playback video frames are presented by the refresh timer, in this very thread
+    QObject::connect(&demuxer, &QmlAVDemuxer::frameFinished, &loop, [&](const std::shared_ptr<QmlAVFrame> frame) {
+        if (frame->type() == QmlAVFrame::TypeVideo) {
+            presented.push_back(frame->pts() - frame->startPts());
+            presentedAfterEnd |= endOfMedia;
+        }
+    });
+    QObject::connect(&demuxer, &QmlAVDemuxer::mediaStatusChanged, &loop, [&](QMediaPlayer::MediaStatus status) {
+        if (status == QMediaPlayer::EndOfMedia) {
+            endOfMedia = true;
+        }
+    });
+    QObject::connect(&demuxer, &QmlAVDemuxer::playbackStateChanged, &loop, [&](QMediaPlayer::State state) {
+        if (state == QMediaPlayer::StoppedState) {
+            loop.quit();
+        }
+    });
+    QTimer::singleShot(10000, &loop, &QEventLoop::quit);
+
+    demuxer.load(QUrl::fromLocalFile(fileName), QmlAVOptions());
+    demuxer.start();
+    loop.exec();
+
+    EXPECT_TRUE(endOfMedia);
+    EXPECT_FALSE(presentedAfterEnd);
+
+    // The late frames may be superseded by the next ones, but never the last one
+    ASSERT_FALSE(presented.empty());
+    EXPECT_NEAR(presented.back(), (FRAMES_COUNT - 1) * AV_TIME_BASE / 25, 1000);
+}
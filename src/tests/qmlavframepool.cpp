@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "./../qmlavframepool.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+}
+
+// The data pointer of a frame taken and released right away, i.e. of the buffer the pool keeps for the geometry
+static uint8_t *recycledData(QmlAVFramePool &framePool, int width)
+{
+    AVFramePtr avFrame = framePool.frame(width, 64, AV_PIX_FMT_YUV420P);
+    return avFrame ? avFrame->data[0] : nullptr;
+}
+
+TEST(QmlAVFramePool, Frame_Geometry)
+{
+    QmlAVFramePool framePool;
+
+    AVFramePtr avFrame = framePool.frame(100, 50, AV_PIX_FMT_YUV420P);
+    ASSERT_TRUE(avFrame);
+    EXPECT_EQ(avFrame->width, 100);
+    EXPECT_EQ(avFrame->height, 50);
+    EXPECT_EQ(avFrame->format, AV_PIX_FMT_YUV420P);
+    EXPECT_GE(avFrame->linesize[0], 100);
+    EXPECT_GE(avFrame->buf[0]->size, av_image_get_buffer_size(AV_PIX_FMT_YUV420P, 100, 50, FFMPEG_ALIGNMENT));
+
+    EXPECT_FALSE(framePool.frame(0, 50, AV_PIX_FMT_YUV420P));
+}
+
+TEST(QmlAVFramePool, Frame_Recycled)
+{
+    QmlAVFramePool framePool;
+
+    uint8_t *data = recycledData(framePool, 64);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(recycledData(framePool, 64), data);
+
+    // A busy buffer isn't handed out twice
+    AVFramePtr avFrame = framePool.frame(64, 64, AV_PIX_FMT_YUV420P);
+    EXPECT_NE(recycledData(framePool, 64), avFrame->data[0]);
+}
+
+TEST(QmlAVFramePool, Pools_EvictLeastRecentlyUsed)
+{
+    QmlAVFramePool framePool;
+
+    // The frame outlives the pool of its geometry
+    AVFramePtr avFrame = framePool.frame(128, 64, AV_PIX_FMT_YUV420P);
+    ASSERT_TRUE(avFrame);
+
+    // As many geometries as the pool holds (FRAME_POOLS_LIMIT), 64 is the smallest but not the oldest one
+    std::map<int, uint8_t *> data;
+    for (int width : {64, 192, 256}) {
+        data[width] = recycledData(framePool, width);
+        ASSERT_NE(data[width], nullptr);
+    }
+
+    // Pushes out 128, the least recently used
+    data[320] = recycledData(framePool, 320);
+    ASSERT_NE(data[320], nullptr);
+
+    std::memset(avFrame->data[0], 0x80, avFrame->linesize[0] * avFrame->height);
+    avFrame.unref();
+
+    // NOTE: The evicted buffer addresses can be reused, so only the kept geometries are checked
+    for (int width : {64, 192, 256, 320}) {
+        EXPECT_EQ(recycledData(framePool, width), data[width]) << "width " << width;
+    }
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "./../qmlavopenscheduler.h"
+#include "qmlavtestutils.h"
+
+// Not the process-wide instance, so that the tests don't share the slots
+class TestOpenScheduler : public QmlAVOpenScheduler
+{
+public:
+    TestOpenScheduler(int limit) { setLimit(limit); }
+
+    // NOTE: The scheduler doesn't notify about the arrivals, nothing to wait on but the count itself
+    void waitForWaiting(int count) const {
+        while (waitingCount() < count) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+TEST(QmlAVOpenScheduler, Limit)
+{
+    const int limit = 2;
+    const int ticketsCount = 5;
+
+    TestOpenScheduler scheduler(limit);
+    std::vector<QmlAVOpenScheduler::Ticket> tickets(ticketsCount);
+
+    std::mutex mutex;
+    int running = 0;
+    int maxRunning = 0;
+    Progress granted;
+    Progress proceed;
+
+    std::vector<std::thread> threads;
+    for (auto &ticket : tickets) {
+        threads.emplace_back([&]() {
+            auto slot = scheduler.acquire(ticket);
+            ASSERT_TRUE(slot);
+            {
+                std::scoped_lock lock(mutex);
+                maxRunning = std::max(maxRunning, ++running);
+            }
+            granted.add();
+
+            proceed.waitFor(1);
+            {
+                std::scoped_lock lock(mutex);
+                --running;
+            }
+        });
+    }
+
+    // The rest wait for the slots held
+    granted.waitFor(limit);
+    scheduler.waitForWaiting(ticketsCount - limit);
+    EXPECT_EQ(granted.value(), limit);
+
+    proceed.add();
+    granted.waitFor(ticketsCount);
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(maxRunning, limit);
+}
+
+TEST(QmlAVOpenScheduler, Order_PriorityThenArrival)
+{
+    TestOpenScheduler scheduler(1);
+
+    const int priorities[] = {0, 1, 0, 1, 0};
+    std::vector<QmlAVOpenScheduler::Ticket> tickets(std::size(priorities));
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::thread> threads;
+
+    {
+        QmlAVOpenScheduler::Ticket holder;
+        auto slot = scheduler.acquire(holder);
+        ASSERT_TRUE(slot);
+
+        for (int i = 0; i < static_cast<int>(tickets.size()); ++i) {
+            scheduler.setPriority(tickets[i], priorities[i]);
+            threads.emplace_back([&, i]() {
+                auto s = scheduler.acquire(tickets[i]);
+                EXPECT_TRUE(s);
+
+                std::scoped_lock lock(mutex);
+                order.push_back(i);
+            });
+
+            // The arrival order is the one of the loop
+            scheduler.waitForWaiting(i + 1);
+        }
+
+        // While waiting
+        scheduler.setPriority(tickets[4], 2);
+    } // The slot is released, the waiting ones are granted one by one
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(order, std::vector<int>({4, 1, 3, 0, 2}));
+}
+
+TEST(QmlAVOpenScheduler, Cancel)
+{
+    TestOpenScheduler scheduler(1);
+
+    QmlAVOpenScheduler::Ticket holder;
+    auto slot = scheduler.acquire(holder);
+    ASSERT_TRUE(slot);
+
+    QmlAVOpenScheduler::Ticket waiting;
+    bool granted = true;
+    std::thread t([&]() {
+        granted = static_cast<bool>(scheduler.acquire(waiting));
+    });
+
+    scheduler.waitForWaiting(1);
+    scheduler.cancel(waiting);
+    t.join();
+
+    EXPECT_FALSE(granted);
+    EXPECT_EQ(scheduler.waitingCount(), 0);
+
+    // Cancelled for good, e.g. the player is destroyed while its loader is still starting
+    EXPECT_FALSE(scheduler.acquire(waiting));
+}
+
+TEST(QmlAVOpenScheduler, SetLimit_WakesWaiting)
+{
+    TestOpenScheduler scheduler(1);
+
+    QmlAVOpenScheduler::Ticket holder;
+    auto slot = scheduler.acquire(holder);
+    ASSERT_TRUE(slot);
+
+    QmlAVOpenScheduler::Ticket waiting;
+    bool granted = false;
+    std::thread t([&]() {
+        granted = static_cast<bool>(scheduler.acquire(waiting));
+    });
+
+    scheduler.waitForWaiting(1);
+    scheduler.setLimit(2);
+    t.join();
+
+    EXPECT_TRUE(granted);
+}
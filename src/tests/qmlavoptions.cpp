@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "./../qmlavoptions.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+static AVCodecParameters codecParameters(AVMediaType type)
+{
+    AVCodecParameters avCodecPar = {};
+    avCodecPar.codec_type = type;
+
+    return avCodecPar;
+}
+
+TEST(QmlAVOptions, ThreadCount_StreamOptPrecedence)
+{
+    const AVCodecParameters video = codecParameters(AVMEDIA_TYPE_VIDEO);
+    const AVCodecParameters audio = codecParameters(AVMEDIA_TYPE_AUDIO);
+
+    QmlAVOptions avOptions(QVariantMap{{"threads", "2"}, {"threads:v", "share"}});
+
+    EXPECT_EQ(avOptions.threadCount(&video), QmlAVOptions::ShareThreadCount);
+    EXPECT_EQ(avOptions.threadCount(&audio), 2);
+    EXPECT_EQ(avOptions.threadCount(nullptr), 2);
+}
+
+TEST(QmlAVOptions, ThreadCount_Invalid)
+{
+    const AVCodecParameters video = codecParameters(AVMEDIA_TYPE_VIDEO);
+
+    EXPECT_EQ(QmlAVOptions().threadCount(&video), std::nullopt);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"threads", "0"}}).threadCount(&video), 0);
+    // Left to FFmpeg as before
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"threads", "auto"}}).threadCount(&video), 0);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"threads", "-1"}}).threadCount(&video), std::nullopt);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"threads", "many"}}).threadCount(&video), std::nullopt);
+}
+
+TEST(QmlAVOptions, ThreadType)
+{
+    const AVCodecParameters video = codecParameters(AVMEDIA_TYPE_VIDEO);
+    const AVCodecParameters audio = codecParameters(AVMEDIA_TYPE_AUDIO);
+
+    QmlAVOptions avOptions(QVariantMap{{"thread_type", "slice+frame"}, {"thread_type:a", "frame"}});
+
+    EXPECT_EQ(avOptions.threadType(&video), FF_THREAD_FRAME | FF_THREAD_SLICE);
+    EXPECT_EQ(avOptions.threadType(&audio), FF_THREAD_FRAME);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"thread_type", "auto"}}).threadType(&video), std::nullopt);
+}
+
+TEST(QmlAVOptions, ProbeCache)
+{
+    EXPECT_EQ(QmlAVOptions().probeCache(), std::nullopt);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"probe_cache", ""}}).probeCache(), true);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"probe_cache", "false"}}).probeCache(), false);
+
+    EXPECT_EQ(QmlAVOptions().probeCacheFile(), "");
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"probe_cache_file", "/tmp/probe.json"}}).probeCacheFile(), "/tmp/probe.json");
+}
+
+TEST(QmlAVOptions, WarmReconnect)
+{
+    EXPECT_FALSE(QmlAVOptions().warmReconnect());
+    EXPECT_TRUE(QmlAVOptions(QVariantMap{{"warm_reconnect", "true"}}).warmReconnect());
+    EXPECT_FALSE(QmlAVOptions(QVariantMap{{"warm_reconnect", "false"}}).warmReconnect());
+}
+
+TEST(QmlAVOptions, OpenConcurrency)
+{
+    EXPECT_EQ(QmlAVOptions().openConcurrency(), std::nullopt);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"open_concurrency", "4"}}).openConcurrency(), 4);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"open_concurrency", "0"}}).openConcurrency(), std::nullopt);
+}
+
+TEST(QmlAVOptions, ReadAhead)
+{
+    EXPECT_EQ(QmlAVOptions().readAheadSize(), 0u);
+    EXPECT_EQ(QmlAVOptions().readAheadDelay(), 100000u);
+
+    QmlAVOptions avOptions(QVariantMap{{"read_ahead_size", "4194304"}, {"read_ahead_delay", "0"}});
+    EXPECT_EQ(avOptions.readAheadSize(), 4194304u);
+    EXPECT_EQ(avOptions.readAheadDelay(), 0u);
+}
+
+TEST(QmlAVOptions, RecordQueueSize)
+{
+    EXPECT_EQ(QmlAVOptions().recordQueueSize(), 16u * 1024 * 1024);
+    EXPECT_EQ(QmlAVOptions(QVariantMap{{"record_queue_size", "1048576"}}).recordQueueSize(), 1048576u);
+}
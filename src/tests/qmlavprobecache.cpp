@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+
+#include <QTemporaryDir>
+
+#include "./../qmlavprobecache.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// Not the process-wide instance, so that the file can be reloaded by a new one
+class TestProbeCache : public QmlAVProbeCache
+{
+public:
+    TestProbeCache(const QString &fileName = QString()) : QmlAVProbeCache(fileName) { }
+};
+
+using AVFormatContextPtr = std::unique_ptr<AVFormatContext, void (*)(AVFormatContext *)>;
+
+// As opened, before the streams are probed
+static AVFormatContextPtr openedContext()
+{
+    AVFormatContextPtr avFormatCtx(avformat_alloc_context(), avformat_free_context);
+
+    AVStream *video = avformat_new_stream(avFormatCtx.get(), nullptr);
+    video->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    video->codecpar->codec_id = AV_CODEC_ID_H264;
+
+    AVStream *audio = avformat_new_stream(avFormatCtx.get(), nullptr);
+    audio->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
+    audio->codecpar->codec_id = AV_CODEC_ID_AAC;
+
+    return avFormatCtx;
+}
+
+static AVFormatContextPtr probedContext()
+{
+    AVFormatContextPtr avFormatCtx = openedContext();
+
+    AVStream *video = avFormatCtx->streams[0];
+    video->codecpar->format = AV_PIX_FMT_YUV420P;
+    video->codecpar->width = 1280;
+    video->codecpar->height = 720;
+    video->codecpar->profile = 100;
+    video->codecpar->color_space = AVCOL_SPC_BT709;
+    video->avg_frame_rate = {25, 1};
+    video->r_frame_rate = {25, 1};
+
+    const uint8_t extradata[] = {0x01, 0x64, 0x00, 0x1f, 0xff};
+    video->codecpar->extradata = static_cast<uint8_t *>(av_mallocz(sizeof(extradata) + AV_INPUT_BUFFER_PADDING_SIZE));
+    memcpy(video->codecpar->extradata, extradata, sizeof(extradata));
+    video->codecpar->extradata_size = sizeof(extradata);
+
+    AVStream *audio = avFormatCtx->streams[1];
+    audio->codecpar->format = AV_SAMPLE_FMT_FLTP;
+    audio->codecpar->sample_rate = 48000;
+    audio->codecpar->frame_size = 1024;
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(59, 24, 100)
+    audio->codecpar->channels = 2;
+    audio->codecpar->channel_layout = AV_CH_LAYOUT_STEREO;
+#else
+    av_channel_layout_default(&audio->codecpar->ch_layout, 2);
+#endif
+
+    return avFormatCtx;
+}
+
+static void expectRestored(const AVFormatContext *restored, const AVFormatContext *probed)
+{
+    for (unsigned int i = 0; i < probed->nb_streams; ++i) {
+        const AVCodecParameters *r = restored->streams[i]->codecpar;
+        const AVCodecParameters *p = probed->streams[i]->codecpar;
+
+        EXPECT_EQ(r->codec_type, p->codec_type);
+        EXPECT_EQ(r->codec_id, p->codec_id);
+        EXPECT_EQ(r->format, p->format);
+        EXPECT_EQ(r->width, p->width);
+        EXPECT_EQ(r->height, p->height);
+        EXPECT_EQ(r->profile, p->profile);
+        EXPECT_EQ(r->color_space, p->color_space);
+        EXPECT_EQ(r->sample_rate, p->sample_rate);
+        EXPECT_EQ(r->frame_size, p->frame_size);
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(59, 24, 100)
+        EXPECT_EQ(r->channels, p->channels);
+        EXPECT_EQ(r->channel_layout, p->channel_layout);
+#else
+        EXPECT_EQ(av_channel_layout_compare(&r->ch_layout, &p->ch_layout), 0);
+#endif
+        ASSERT_EQ(r->extradata_size, p->extradata_size);
+        EXPECT_EQ(memcmp(r->extradata, p->extradata, p->extradata_size), 0);
+
+        EXPECT_EQ(av_cmp_q(restored->streams[i]->avg_frame_rate, probed->streams[i]->avg_frame_rate), 0);
+        EXPECT_EQ(av_cmp_q(restored->streams[i]->r_frame_rate, probed->streams[i]->r_frame_rate), 0);
+    }
+}
+
+TEST(QmlAVProbeCache, RoundTrip_Memory)
+{
+    TestProbeCache cache;
+
+    AVFormatContextPtr probed = probedContext();
+    cache.store("rtsp://camera/1", probed.get());
+
+    AVFormatContextPtr opened = openedContext();
+    EXPECT_FALSE(cache.restore("rtsp://camera/2", opened.get()));
+    ASSERT_TRUE(cache.restore("rtsp://camera/1", opened.get()));
+    expectRestored(opened.get(), probed.get());
+}
+
+TEST(QmlAVProbeCache, RoundTrip_File)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString fileName = dir.filePath("probe_cache.json");
+
+    AVFormatContextPtr probed = probedContext();
+
+    {
+        TestProbeCache cache(fileName);
+        cache.store("rtsp://camera/1", probed.get());
+    } // The pending changes are saved on destruction
+
+    TestProbeCache cache(fileName);
+
+    AVFormatContextPtr opened = openedContext();
+    ASSERT_TRUE(cache.restore("rtsp://camera/1", opened.get()));
+    expectRestored(opened.get(), probed.get());
+}
+
+TEST(QmlAVProbeCache, Restore_Mismatch)
+{
+    TestProbeCache cache;
+
+    AVFormatContextPtr probed = probedContext();
+    cache.store("rtsp://camera/1", probed.get());
+
+    // The source has been reconfigured since
+    AVFormatContextPtr opened = openedContext();
+    opened->streams[0]->codecpar->codec_id = AV_CODEC_ID_HEVC;
+    EXPECT_FALSE(cache.restore("rtsp://camera/1", opened.get()));
+
+    // The entry is dropped
+    opened = openedContext();
+    EXPECT_FALSE(cache.restore("rtsp://camera/1", opened.get()));
+}
+
+TEST(QmlAVProbeCache, Entries_EvictLeastRecentlyUsed)
+{
+    TestProbeCache cache;
+
+    AVFormatContextPtr probed = probedContext();
+
+    // As many as the cache holds (PROBE_CACHE_LIMIT), the first one is the oldest
+    const int limit = 64;
+    for (int i = 0; i < limit; ++i) {
+        cache.store(QString("rtsp://camera/%1").arg(i), probed.get());
+    }
+
+    AVFormatContextPtr opened = openedContext();
+    ASSERT_TRUE(cache.restore("rtsp://camera/0", opened.get()));
+
+    // Pushes out 1, the least recently used
+    cache.store("rtsp://camera/new", probed.get());
+
+    opened = openedContext();
+    EXPECT_TRUE(cache.restore("rtsp://camera/0", opened.get()));
+    opened = openedContext();
+    EXPECT_FALSE(cache.restore("rtsp://camera/1", opened.get()));
+    opened = openedContext();
+    EXPECT_TRUE(cache.restore("rtsp://camera/2", opened.get()));
+    opened = openedContext();
+    EXPECT_TRUE(cache.restore("rtsp://camera/new", opened.get()));
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "./../qmlavreadahead.h"
+#include "./../qmlavmediacontextholder.h"
+#include "./../qmlavoptions.h"
+
+#define RING_SIZE (256 * 1024)
+#define FILE_SIZE (1024 * 1024) // Wraps around the ring a few times
+
+// The file protocol is a byte stream just like the network ones
+class ReadAheadTest : public ::testing::Test
+{
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(m_dir.isValid());
+
+        m_data.resize(FILE_SIZE);
+        for (int i = 0; i < m_data.size(); ++i) {
+            m_data[i] = static_cast<char>(i * 7 + i / 251);
+        }
+
+        QFile file(fileName());
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+        ASSERT_EQ(file.write(m_data), m_data.size());
+    }
+
+    QString fileName() const { return m_dir.filePath("stream.bin"); }
+
+    // Everything the demuxer gets, up to the end of the stream or an error
+    static QByteArray readAll(AVIOContext *avioCtx, int &error) {
+        QByteArray data;
+        uint8_t buf[4096];
+
+        for (;;) {
+            int ret = avio_read(avioCtx, buf, sizeof(buf));
+            if (ret <= 0) {
+                error = ret;
+                return data;
+            }
+            data.append(reinterpret_cast<const char *>(buf), ret);
+        }
+    }
+
+    QTemporaryDir m_dir;
+    QByteArray m_data;
+};
+
+TEST_F(ReadAheadTest, RoundTrip)
+{
+    QmlAVInterruptCallback interruptCallback;
+    QmlAVReadAheadIO readAhead(RING_SIZE, 0, 30000000, interruptCallback);
+    ASSERT_TRUE(readAhead.open(fileName(), QmlAVOptions()));
+
+    int error = 0;
+    EXPECT_EQ(readAll(readAhead.avioContext(), error), m_data);
+    EXPECT_EQ(error, AVERROR_EOF);
+}
+
+TEST_F(ReadAheadTest, RoundTrip_Delay)
+{
+    QmlAVInterruptCallback interruptCallback;
+    QmlAVReadAheadIO readAhead(RING_SIZE, 10000, 30000000, interruptCallback);
+    ASSERT_TRUE(readAhead.open(fileName(), QmlAVOptions()));
+
+    int error = 0;
+    EXPECT_EQ(readAll(readAhead.avioContext(), error), m_data);
+    EXPECT_EQ(error, AVERROR_EOF);
+}
+
+TEST_F(ReadAheadTest, DemuxerTimerIgnored)
+{
+    // Expired, as if the demuxer were waiting for the decoders meanwhile
+    QmlAVInterruptCallback interruptCallback;
+    interruptCallback.setTimeout(1);
+
+    QmlAVReadAheadIO readAhead(RING_SIZE, 0, 30000000, interruptCallback);
+    ASSERT_TRUE(readAhead.open(fileName(), QmlAVOptions()));
+
+    int error = 0;
+    EXPECT_EQ(readAll(readAhead.avioContext(), error), m_data);
+    EXPECT_EQ(error, AVERROR_EOF);
+}
+
+TEST_F(ReadAheadTest, DemuxerInterrupt)
+{
+    QmlAVInterruptCallback interruptCallback;
+    QmlAVReadAheadIO readAhead(RING_SIZE, 0, 30000000, interruptCallback);
+    ASSERT_TRUE(readAhead.open(fileName(), QmlAVOptions()));
+
+    // The reader can't get further than the ring (and the protocol buffer) holds meanwhile
+    interruptCallback.requestAVInterrupt();
+
+    int error = 0;
+    QByteArray data = readAll(readAhead.avioContext(), error);
+    EXPECT_LT(data.size(), m_data.size());
+    EXPECT_EQ(data, m_data.left(data.size())); // The buffered data first
+    EXPECT_EQ(error, AVERROR_EXIT);
+}
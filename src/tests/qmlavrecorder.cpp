@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "./../qmlavrecorder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+static const AVRational s_timeBase = {1, 90000};
+
+static AVPacketPtr packet(int64_t dts, bool keyFrame)
+{
+    AVPacketPtr avPacket;
+    av_new_packet(avPacket, 16);
+    avPacket->dts = dts;
+    avPacket->pts = dts;
+    avPacket->duration = 3600;
+    if (keyFrame) {
+        avPacket->flags |= AV_PKT_FLAG_KEY;
+    }
+
+    return avPacket;
+}
+
+// The DTS of the written packets in s_timeBase, as listed by the "framecrc" muxer
+static std::vector<int64_t> writtenDts(const QString &fileName)
+{
+    std::vector<int64_t> dts;
+    AVRational timeBase = s_timeBase;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return dts;
+    }
+
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+
+        if (line.startsWith("#tb 0:")) {
+            const QStringList q = line.mid(6).trimmed().split('/');
+            timeBase = {q.value(0).toInt(), q.value(1).toInt()};
+        } else if (!line.startsWith('#') && !line.isEmpty()) {
+            dts.push_back(av_rescale_q(line.split(',').value(1).trimmed().toLongLong(), timeBase, s_timeBase));
+        }
+    }
+
+    return dts;
+}
+
+TEST(QmlAVRecorder, Rebase)
+{
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString fileName = dir.filePath("record.crc");
+
+    AVCodecParameters *codecPar = avcodec_parameters_alloc();
+    codecPar->codec_type = AVMEDIA_TYPE_VIDEO;
+    codecPar->codec_id = AV_CODEC_ID_H264;
+    codecPar->width = 64;
+    codecPar->height = 64;
+
+    {
+        QmlAVRecorder recorder(fileName, QmlAVOptions(QVariantMap{{"f", "framecrc"}}));
+        recorder.addStream(QmlAVDecoder::TypeVideo, codecPar, s_timeBase);
+        recorder.start();
+
+        // The recording starts with a keyframe, from zero
+        recorder.write(QmlAVDecoder::TypeVideo, packet(896400, false));
+        recorder.write(QmlAVDecoder::TypeVideo, packet(900000, true));
+        recorder.write(QmlAVDecoder::TypeVideo, packet(903600, false));
+
+        // Reconnected, the timestamps continue from the end of the written ones
+        recorder.discontinuity();
+        recorder.write(QmlAVDecoder::TypeVideo, packet(7200, false));
+        recorder.write(QmlAVDecoder::TypeVideo, packet(3600, true));
+        recorder.write(QmlAVDecoder::TypeVideo, packet(7200, false));
+
+        // The queued packets are written out first
+        recorder.stop();
+        while (!recorder.isFinished()) {
+            std::this_thread::yield();
+        }
+
+        // The ones before the keyframes, before the first one and after the reconnect
+        EXPECT_EQ(recorder.counters().packetsWritten.get(), 4u);
+        EXPECT_EQ(recorder.counters().packetsDropped.get(), 2u);
+    }
+
+    avcodec_parameters_free(&codecPar);
+
+    EXPECT_EQ(writtenDts(fileName), std::vector<int64_t>({0, 3600, 7200, 10800}));
+}
@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "./../qmlavscaler.h"
+
+extern "C" {
+#include <libavutil/cpu.h>
+#include <libavutil/frame.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+class TestScaler : public QmlAVScaler
+{
+public:
+    using QmlAVScaler::QmlAVScaler;
+    using QmlAVScaler::Key;
+    using QmlAVScaler::acquire;
+    using QmlAVScaler::release;
+    using QmlAVScaler::repack;
+};
+
+static TestScaler::Key key(int width)
+{
+    return {width, 64, AV_PIX_FMT_YUV420P, width, 64, AV_PIX_FMT_RGBA};
+}
+
+TEST(QmlAVScaler, ContextCache_Reuse)
+{
+    QmlAVFramePool framePool;
+    TestScaler scaler(framePool);
+
+    SwsContext *swsCtx = scaler.acquire(key(64));
+    ASSERT_NE(swsCtx, nullptr);
+    scaler.release(key(64), swsCtx);
+
+    // The same geometry gets the cached context back, which is busy until released
+    EXPECT_EQ(scaler.acquire(key(64)), swsCtx);
+    SwsContext *other = scaler.acquire(key(64));
+    ASSERT_NE(other, nullptr);
+    EXPECT_NE(other, swsCtx);
+
+    scaler.release(key(64), other);
+    scaler.release(key(64), swsCtx);
+}
+
+TEST(QmlAVScaler, ContextCache_EvictsLeastRecentlyUsed)
+{
+    QmlAVFramePool framePool;
+    TestScaler scaler(framePool);
+
+    // As many as the cache holds (SWS_CONTEXTS_LIMIT)
+    const int widths[] = {64, 128, 192, 256};
+    std::map<int, SwsContext *> contexts;
+
+    for (int width : widths) {
+        contexts[width] = scaler.acquire(key(width));
+        ASSERT_NE(contexts[width], nullptr);
+    }
+    for (int width : widths) {
+        scaler.release(key(width), contexts[width]);
+    }
+
+    // The oldest but the most recently used one
+    ASSERT_EQ(scaler.acquire(key(64)), contexts[64]);
+    scaler.release(key(64), contexts[64]);
+
+    // Pushes out 128, the least recently used
+    SwsContext *swsCtx = scaler.acquire(key(320));
+    ASSERT_NE(swsCtx, nullptr);
+    scaler.release(key(320), swsCtx);
+    contexts[320] = swsCtx;
+
+    // NOTE: The evicted context address can be reused, so only the kept ones are checked
+    for (int width : {64, 192, 256, 320}) {
+        EXPECT_EQ(scaler.acquire(key(width)), contexts[width]) << "width " << width;
+    }
+    for (int width : {64, 192, 256, 320}) {
+        scaler.release(key(width), contexts[width]);
+    }
+}
+
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+static int64_t contextThreads(SwsContext *swsCtx)
+{
+    int64_t threads = 0;
+    av_opt_get_int(swsCtx, "threads", 0, &threads);
+
+    return threads;
+}
+
+TEST(QmlAVScaler, AutoThreads_SharedAcrossScalers)
+{
+    QmlAVFramePool framePool;
+
+    // A scaler per tile of a wall, more than the cores
+    std::vector<std::unique_ptr<TestScaler>> scalers;
+    for (int i = 0; i <= av_cpu_count(); ++i) {
+        scalers.push_back(std::make_unique<TestScaler>(framePool));
+    }
+
+    std::vector<SwsContext *> contexts;
+    for (auto &scaler : scalers) {
+        contexts.push_back(scaler->acquire(key(64)));
+        ASSERT_NE(contexts.back(), nullptr);
+    }
+
+    EXPECT_GE(contextThreads(contexts.front()), 1);
+    EXPECT_EQ(contextThreads(contexts.back()), 1);
+
+    for (size_t i = 0; i < scalers.size(); ++i) {
+        scalers[i]->release(key(64), contexts[i]);
+    }
+    scalers.clear();
+
+    // The released shares go to the next ones
+    TestScaler scaler(framePool);
+    SwsContext *swsCtx = scaler.acquire(key(64));
+    ASSERT_NE(swsCtx, nullptr);
+    EXPECT_EQ(contextThreads(swsCtx), std::min(av_cpu_count(), 4));
+    scaler.release(key(64), swsCtx);
+}
+#endif
+
+// Smooth planes, the chroma sample positions of the repack and swscale may differ by a fraction of a pixel
+static AVFramePtr gradientFrame(int width, int height, AVPixelFormat format)
+{
+    AVFramePtr avFrame;
+    avFrame->width = width;
+    avFrame->height = height;
+    avFrame->format = format;
+    if (av_frame_get_buffer(avFrame, 0) < 0) {
+        avFrame.unref();
+        return avFrame;
+    }
+
+    const int chromaWidth = format == AV_PIX_FMT_YUV444P ? width : (width + 1) >> 1;
+    const int chromaHeight = format == AV_PIX_FMT_YUV420P ? (height + 1) >> 1 : height;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            avFrame->data[0][y * avFrame->linesize[0] + x] = 16 + (x + y) / 2;
+        }
+    }
+    for (int y = 0; y < chromaHeight; ++y) {
+        for (int x = 0; x < chromaWidth; ++x) {
+            avFrame->data[1][y * avFrame->linesize[1] + x] = 64 + x * width / chromaWidth / 2;
+            avFrame->data[2][y * avFrame->linesize[2] + x] = 192 - y * height / chromaHeight / 2;
+        }
+    }
+
+    return avFrame;
+}
+
+static int maxPlaneDiff(const AVFrame *a, const AVFrame *b, int plane, int width, int height)
+{
+    int diff = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            diff = std::max(diff, std::abs(a->data[plane][y * a->linesize[plane] + x] - b->data[plane][y * b->linesize[plane] + x]));
+        }
+    }
+
+    return diff;
+}
+
+static void testRepack(AVPixelFormat srcFormat, int width, int height)
+{
+    QmlAVFramePool framePool;
+    TestScaler scaler(framePool);
+
+    AVFramePtr srcFrame = gradientFrame(width, height, srcFormat);
+    ASSERT_TRUE(srcFrame);
+
+    AVFramePtr dstFrame = scaler.repack(srcFrame, srcFormat, AV_PIX_FMT_YUV420P);
+    ASSERT_TRUE(dstFrame);
+    ASSERT_EQ(dstFrame->format, AV_PIX_FMT_YUV420P);
+
+    AVFramePtr swsFrame;
+    swsFrame->width = width;
+    swsFrame->height = height;
+    swsFrame->format = AV_PIX_FMT_YUV420P;
+    ASSERT_GE(av_frame_get_buffer(swsFrame, 0), 0);
+
+    SwsContext *swsCtx = sws_getContext(width, height, srcFormat, width, height, AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    ASSERT_NE(swsCtx, nullptr);
+    sws_scale(swsCtx, srcFrame->data, srcFrame->linesize, 0, height, swsFrame->data, swsFrame->linesize);
+    sws_freeContext(swsCtx);
+
+    const int chromaWidth = (width + 1) >> 1;
+    const int chromaHeight = (height + 1) >> 1;
+
+    EXPECT_LE(maxPlaneDiff(dstFrame, swsFrame, 0, width, height), 1);
+    EXPECT_LE(maxPlaneDiff(dstFrame, swsFrame, 1, chromaWidth, chromaHeight), 2);
+    EXPECT_LE(maxPlaneDiff(dstFrame, swsFrame, 2, chromaWidth, chromaHeight), 2);
+}
+
+TEST(QmlAVScaler, Repack_422_AsSwscale)
+{
+    testRepack(AV_PIX_FMT_YUV422P, 64, 48);
+    testRepack(AV_PIX_FMT_YUV422P, 63, 47);
+}
+
+TEST(QmlAVScaler, Repack_444_AsSwscale)
+{
+    testRepack(AV_PIX_FMT_YUV444P, 64, 48);
+    testRepack(AV_PIX_FMT_YUV444P, 63, 47);
+}
+
+TEST(QmlAVScaler, Repack_Unsupported)
+{
+    QmlAVFramePool framePool;
+    TestScaler scaler(framePool);
+
+    AVFramePtr srcFrame = gradientFrame(64, 48, AV_PIX_FMT_YUV420P);
+    ASSERT_TRUE(srcFrame);
+
+    // Left to swscale
+    EXPECT_FALSE(scaler.repack(srcFrame, AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P));
+}
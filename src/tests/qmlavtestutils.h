@@ -0,0 +1,36 @@
+#ifndef QMLAVTESTUTILS_H
+#define QMLAVTESTUTILS_H
+
+#include <mutex>
+#include <condition_variable>
+
+// The tests wait for the observed progress rather than sleep, so they don't depend on the machine load
+class Progress
+{
+public:
+    void add(int n = 1) {
+        {
+            std::scoped_lock lock(m_mutex);
+            m_value += n;
+        }
+        m_cond.notify_all();
+    }
+    int value() const {
+        std::scoped_lock lock(m_mutex);
+        return m_value;
+    }
+    void waitFor(int value) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [&] {
+            // Executes in lock context
+            return m_value >= value;
+        });
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    int m_value = 0;
+};
+
+#endif // QMLAVTESTUTILS_H
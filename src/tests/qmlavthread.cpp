@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include "./../qmlavthread.h"
+#include "qmlavtestutils.h"
 
 template<typename T>
 std::decay_t<T> generic_fn(T t)
@@ -266,3 +267,430 @@ TEST(QmlAVThread, QmlAVTask_DemuxerDecoderThreadModel)
 
     decoderThread.requestInterrupt(true);
 }
+
+TEST(QmlAVThread, Pooled_RunLambda)
+{
+    QmlAVThreadLiveController<int> c = QmlAVThread::runPooled([](int n) { return n; }, 42);
+
+    EXPECT_EQ(c.result(), 42);
+}
+
+TEST(QmlAVThread, Pooled_LoopLambda)
+{
+    int n = 0;
+
+    QmlAVThreadLiveController<QmlAVLoopController> c = QmlAVThread::loopPooled([&]() -> QmlAVLoopController {
+        if (++n < 42) {
+            return QmlAVLoopController::Continue;
+        }
+
+        return QmlAVLoopController::Break;
+    });
+    c.waitForFinished();
+
+    EXPECT_EQ(n, 42);
+}
+
+TEST(QmlAVThread, Pooled_QmlAVTask_VoidResult)
+{
+    int processed = 0;
+
+    auto t = QmlAVThreadTask([&](int n) { processed += n; });
+    t(10);
+
+    QmlAVThreadLiveController<void> c = t.getLiveController(QmlAVWorkerThread::Pooled);
+    t.argsQueue()->waitForEmpty();
+    EXPECT_TRUE(c.isRunning()); // Parked, but not finished
+
+    t(15);
+    t(17);
+    t.argsQueue()->waitForEmpty();
+    c.requestInterrupt(true);
+
+    EXPECT_EQ(processed, 42);
+    EXPECT_FALSE(c.isRunning());
+}
+
+TEST(QmlAVThread, Pooled_QmlAVTask_DemuxerDecoderThreadModel)
+{
+    const int tasksCount = 1000;
+    const int decodersCount = 16;
+
+    std::vector<QmlAVThreadTask<std::function<int(int)>>> decoderTasks;
+    std::vector<QmlAVThreadLiveController<int>> decoderThreads;
+    for (int i = 0; i < decodersCount; ++i) {
+        decoderTasks.emplace_back([](int n) { return n; });
+        decoderThreads.push_back(decoderTasks.back().getLiveController(QmlAVWorkerThread::Pooled));
+    }
+
+    QmlAVThreadLiveController<void> demuxerThread = QmlAVThread::run([=]() mutable {
+        for (int i = 0; i < tasksCount; ++i) {
+            decoderTasks[i % decodersCount](i);
+        }
+    });
+
+    demuxerThread.waitForFinished();
+
+    for (int i = 0; i < tasksCount; ++i) {
+        EXPECT_EQ(decoderThreads[i % decodersCount].result(), i);
+    }
+
+    for (auto &t : decoderThreads) {
+        t.requestInterrupt(true);
+    }
+}
+
+TEST(QmlAVThread, Pooled_QmlAVTask_SerialInvocation)
+{
+    const int tasksCount = 500;
+    const int producersCount = 4;
+
+    std::atomic<int> inFlight = 0;
+    std::atomic<int> overlaps = 0;
+    int processed = 0;
+
+    auto t = QmlAVThreadTask([&](int n) {
+        if (inFlight++ > 0) {
+            overlaps++;
+        }
+        processed += n;
+        inFlight--;
+    });
+    QmlAVThreadLiveController<void> c = t.getLiveController(QmlAVWorkerThread::Pooled);
+
+    std::vector<QmlAVThreadLiveController<void>> producers;
+    for (int i = 0; i < producersCount; ++i) {
+        producers.push_back(QmlAVThread::run([=]() mutable {
+            for (int j = 0; j < tasksCount; ++j) {
+                t(1);
+            }
+        }));
+    }
+    for (auto &p : producers) {
+        p.waitForFinished();
+    }
+
+    t.argsQueue()->waitForEmpty();
+    c.requestInterrupt(true);
+
+    EXPECT_EQ(overlaps, 0);
+    EXPECT_EQ(processed, tasksCount * producersCount);
+}
+
+TEST(QmlAVThread, Pooled_WorkStealing)
+{
+    const int tasksCount = 8;
+
+    Progress processed;
+
+    std::vector<QmlAVThreadTask<std::function<void(int)>>> tasks;
+    std::vector<QmlAVThreadLiveController<void>> threads;
+    for (int i = 0; i < tasksCount; ++i) {
+        tasks.emplace_back([&](int n) { processed.add(n); });
+        threads.push_back(tasks.back().getLiveController(QmlAVWorkerThread::Pooled));
+    }
+
+    // Tasks woken up from the pool thread are queued locally, so the busy thread
+    // can't run them itself and the others have to steal them. Without stealing, it never returns.
+    QmlAVThreadLiveController<QmlAVLoopController> busyThread = QmlAVThread::loopPooled([&]() -> QmlAVLoopController {
+        for (auto &t : tasks) {
+            t(1);
+        }
+
+        processed.waitFor(tasksCount);
+
+        return QmlAVLoopController::Break;
+    });
+    busyThread.waitForFinished();
+
+    EXPECT_EQ(processed.value(), tasksCount);
+
+    for (auto &t : threads) {
+        t.requestInterrupt(true);
+    }
+}
+
+TEST(QmlAVThread, Pooled_LastControllerInterruptsBusyLoop)
+{
+    Progress n;
+    Progress proceed;
+    std::atomic<bool> destroyed = false;
+    std::thread t;
+
+    {
+        QmlAVThreadLiveController<QmlAVLoopController> c = QmlAVThread::loopPooled([&]() -> QmlAVLoopController {
+            EXPECT_FALSE(destroyed.load());
+
+            n.add();
+            if (n.value() == 1) {
+                // The pool thread holds a reference meanwhile
+                proceed.waitFor(1);
+            }
+
+            return QmlAVLoopController::Continue;
+        });
+
+        // Copies share the thread, only the last one stops it
+        auto copy = c;
+        n.waitFor(1);
+
+        // NOTE: Races with the destruction below, which has to wait for the iteration either way
+        t = std::thread([&]() { proceed.add(); });
+    }
+    // The loop has finished, no iteration may observe it
+    destroyed = true;
+    const int passed = n.value();
+    t.join();
+
+    EXPECT_GE(passed, 1);
+    EXPECT_EQ(n.value(), passed);
+}
+
+template<typename Callable>
+auto loopWithPolicy(QmlAVWorkerThread::Policy policy, Callable &&callable)
+{
+    if (policy == QmlAVWorkerThread::Pooled) {
+        return QmlAVThread::loopPooled(std::forward<Callable>(callable));
+    }
+
+    return QmlAVThread::loop(std::forward<Callable>(callable));
+}
+
+TEST(QmlAVThread, LoopWaitUntil_Wake)
+{
+    for (auto policy : {QmlAVWorkerThread::Dedicated, QmlAVWorkerThread::Pooled}) {
+        Progress n;
+
+        auto c = loopWithPolicy(policy, [&]() -> QmlAVLoopController {
+            n.add();
+            if (n.value() < 3) {
+                return QmlAVLoopController::waitUntil(QmlAVLoopController::Continue);
+            }
+
+            return QmlAVLoopController::Break;
+        });
+
+        // Every wake-up lets exactly one more iteration through
+        int wakes = 0;
+        n.waitFor(1);
+        while (n.value() < 3) {
+            int passed = n.value();
+            c.wake();
+            ++wakes;
+            n.waitFor(passed + 1);
+        }
+        c.waitForFinished();
+
+        EXPECT_EQ(n.value(), 3);
+        // NOTE: Pooled start may count as a wake-up, so the first wait there may be passed through at once
+        if (policy == QmlAVWorkerThread::Dedicated) {
+            EXPECT_EQ(wakes, 2);
+        } else {
+            EXPECT_GE(wakes, 1);
+        }
+    }
+}
+
+TEST(QmlAVThread, LoopWaitUntil_Deadline)
+{
+    for (auto policy : {QmlAVWorkerThread::Dedicated, QmlAVWorkerThread::Pooled}) {
+        int n = 0;
+
+        auto c = loopWithPolicy(policy, [&]() -> QmlAVLoopController {
+            if (++n < 3) {
+                auto deadline = QmlAVLoopController::Clock::now() + std::chrono::milliseconds(10);
+                return QmlAVLoopController::waitUntil(QmlAVLoopController::Continue, deadline);
+            }
+
+            return QmlAVLoopController::Break;
+        });
+        c.waitForFinished();
+
+        EXPECT_EQ(n, 3);
+    }
+}
+
+TEST(QmlAVThread, LoopSleep_Interrupt)
+{
+    for (auto policy : {QmlAVWorkerThread::Dedicated, QmlAVWorkerThread::Pooled}) {
+        Progress n;
+
+        auto c = loopWithPolicy(policy, [&]() -> QmlAVLoopController {
+            n.add();
+            return QmlAVLoopController(QmlAVLoopController::Continue, 60 * 1000 * 1000); // 60 sec.
+        });
+
+        n.waitFor(1);
+
+        // Without the interruption the sleep would last a minute, so the bound is far from the expected time
+        auto start = std::chrono::steady_clock::now();
+        c.requestInterrupt(true);
+
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(30));
+        EXPECT_EQ(n.value(), 1);
+    }
+}
+
+TEST(QmlAVThread, LockFreeQueue_DemuxerDecoderThreadModel)
+{
+    const int tasksCount = 10000;
+
+    auto decoderTask = QmlAVThreadTask<std::function<int(int)>, QmlAVLockFreeStorage<8>>([](int n) {
+        return n;
+    });
+    decoderTask.argsQueue()->setProducerLimit(4); // Exercise the blocking producer
+    QmlAVThreadLiveController<int> decoderThread = decoderTask.getLiveController();
+
+    QmlAVThreadLiveController<void> demuxerThread = QmlAVThread::run([=]() mutable {
+        for (int i = 0; i < tasksCount; ++i) {
+            decoderTask(i);
+        }
+    });
+
+    demuxerThread.waitForFinished();
+
+    for (int i = 0; i < tasksCount; ++i) {
+        EXPECT_EQ(decoderThread.result(), i);
+    }
+
+    decoderThread.requestInterrupt(true);
+}
+
+TEST(QmlAVThread, Pooled_LockFreeQueue_Retry)
+{
+    const int tasksCount = 10000;
+    int processed = 0;
+    int retries = 0;
+
+    auto t = QmlAVThreadTask<std::function<QmlAVLoopController(int)>, QmlAVLockFreeStorage<16>>([&](int n) -> QmlAVLoopController {
+        // Every argument is retried once, the way the decoder drains frames
+        if (n % 2 == 0 && retries < n / 2 + 1) {
+            ++retries;
+            return QmlAVLoopController::Retry;
+        }
+        EXPECT_EQ(n, processed);
+        ++processed;
+        return QmlAVLoopController::Continue;
+    });
+    QmlAVThreadLiveController<QmlAVLoopController> c = t.getLiveController(QmlAVWorkerThread::Pooled);
+
+    for (int i = 0; i < tasksCount; ++i) {
+        t(i);
+    }
+    t.argsQueue()->waitForEmpty();
+    c.requestInterrupt(true);
+
+    EXPECT_EQ(processed, tasksCount);
+    EXPECT_EQ(retries, tasksCount / 2);
+}
+
+template<typename Storage>
+void testWeightLimit()
+{
+    const int tasksCount = 100;
+
+    auto t = QmlAVThreadTask<std::function<int(int)>, Storage>([](int n) { return n; });
+    t.argsQueue()->setWeigher([](const auto &args) {
+        return QmlAVQueueWeight{3, std::get<0>(args)};
+    });
+    t.argsQueue()->setWeightLimit({10, 0});
+
+    Progress enqueued;
+    t.argsQueue()->setNotifier([&] { enqueued.add(); });
+
+    QmlAVThreadLiveController<void> producer = QmlAVThread::run([=]() mutable {
+        for (int i = 0; i < tasksCount; ++i) {
+            t(i);
+        }
+    });
+
+    // 0, 3, 6 and 9 bytes are below the limit, so the fifth value blocks the producer
+    enqueued.waitFor(4);
+    EXPECT_EQ(t.argsQueue()->length(), 4);
+    EXPECT_EQ(t.argsQueue()->weight().bytes, 12);
+    EXPECT_EQ(t.argsQueue()->weight().duration, 0 + 1 + 2 + 3);
+
+    QmlAVThreadLiveController<int> consumer = t.getLiveController();
+    for (int i = 0; i < tasksCount; ++i) {
+        EXPECT_EQ(consumer.result(), i);
+    }
+
+    producer.waitForFinished();
+    EXPECT_EQ(t.argsQueue()->weight().bytes, 0);
+    EXPECT_EQ(t.argsQueue()->weight().duration, 0);
+
+    consumer.requestInterrupt(true);
+}
+
+TEST(QmlAVThread, QmlAVTask_WeightLimit)
+{
+    testWeightLimit<QmlAVLockedStorage>();
+}
+
+TEST(QmlAVThread, LockFreeQueue_WeightLimit)
+{
+    testWeightLimit<QmlAVLockFreeStorage<8>>();
+}
+
+// Stands for AVPacketPtr: the default constructor allocates, unref() only releases the data
+struct RefHolder {
+    static inline int allocations = 0;
+
+    RefHolder() { ++allocations; }
+    void unref() { data.reset(); }
+
+    std::shared_ptr<int> data;
+};
+
+TEST(QmlAVThread, LockFreeQueue_DequeueReleasesInPlace)
+{
+    QmlAVWaitingQueue<std::tuple<int, RefHolder>, QmlAVLockFreeStorage<4>> queue;
+
+    RefHolder value;
+    value.data = std::make_shared<int>(42);
+    queue.enqueue(std::make_tuple(1, value));
+    EXPECT_EQ(value.data.use_count(), 2);
+
+    const int allocations = RefHolder::allocations;
+    queue.dequeue();
+
+    EXPECT_EQ(value.data.use_count(), 1);
+    EXPECT_EQ(RefHolder::allocations, allocations);
+}
+
+TEST(QmlAVThread, QmlAVTask_BatchStopsOnWait)
+{
+    for (auto policy : {QmlAVWorkerThread::Dedicated, QmlAVWorkerThread::Pooled}) {
+        const int tasksCount = 10;
+        Progress processed;
+        std::atomic<bool> woken = false;
+
+        auto t = QmlAVThreadTask<std::function<QmlAVLoopController(int)>>([&](int n) -> QmlAVLoopController {
+            // The batch is cut short by the waiting argument, the rest has to wait for the wake-up
+            // NOTE: Pooled start counts as a wake-up, so the wait there may be passed through at once
+            if (n > tasksCount / 2 && policy == QmlAVWorkerThread::Dedicated) {
+                EXPECT_TRUE(woken);
+            }
+
+            processed.add();
+            if (n == tasksCount / 2) {
+                return QmlAVLoopController::waitUntil(QmlAVLoopController::Continue);
+            }
+            return QmlAVLoopController::Continue;
+        });
+        for (int i = 0; i < tasksCount; ++i) {
+            t(i);
+        }
+
+        QmlAVThreadLiveController<QmlAVLoopController> c = t.getLiveController(policy);
+
+        processed.waitFor(tasksCount / 2 + 1);
+        woken = true;
+        c.wake();
+
+        t.argsQueue()->waitForEmpty();
+        EXPECT_EQ(processed.value(), tasksCount);
+
+        c.requestInterrupt(true);
+    }
+}